@@ -6,11 +6,38 @@
 #define MODES_COUNT 256
 #define MAX_DIMENSIONS 16
 
+// How the voxel grid gets drawn. Selected per mode at runtime so the cost of
+// each can be compared against the same field. Auto picks between cubes and
+// splats by grid size.
+#define VOXEL_RENDERER_AUTO 0
+#define VOXEL_RENDERER_INSTANCED 1
+#define VOXEL_RENDERER_SPLAT 2
+#define VOXEL_RENDERER_RAYMARCHED 3
+#define VOXEL_RENDERER_OIT 4
+#define VOXEL_RENDERERS_COUNT 5
+
+// How many bits each voxel of the field gets, packed into 32 bit words. Also
+// selected per mode at runtime, as how much precision a field needs depends on
+// what it's doing. Only applies to fields stored in a buffer.
+//
+// VOLATILE - these must match field.glsl.
+#define FIELD_PRECISION_FP32 0
+#define FIELD_PRECISION_FP16 1
+#define FIELD_PRECISION_UNORM8 2
+#define FIELD_PRECISIONS_COUNT 3
+
+// Grid lengths are kept to powers of two between these, which keeps them
+// multiples of the 4x4x4 bricks the compute kernels work in.
+#define GRID_MIN_LENGTH 4
+#define GRID_MAX_LENGTH 256
+
 typedef struct
 {
 	char compute_filename[32];
-	uint8_t grid_length; // NOW path 16   holo 8   wave 16
+	uint16_t grid_length; // NOW path 16   holo 8   wave 16
 	uint8_t visible_dimensions;
+	uint8_t renderer;
+	uint8_t field_precision;
 
 	void (*init)(float* data);
 	void (*update)(float* data, Input* input, float dt);
@@ -56,7 +83,7 @@ void game_init(Game* game)
 #define MODES_TMP_COUNT 4
 	game->modes[0] = (Mode) { .compute_filename = "shaders/wave.comp",          .grid_length = 16, .visible_dimensions = 3, .init = wave_mode_init,          .update = wave_mode_update },
 	game->modes[1] = (Mode) { .compute_filename = "shaders/holograph.comp",     .grid_length = 8,  .visible_dimensions = 3, .init = holograph_mode_init,     .update = holograph_mode_update },
-	game->modes[2] = (Mode) { .compute_filename = "shaders/trace.comp",         .grid_length = 16, .visible_dimensions = 3, .init = pathtrace_mode_init,     .update = pathtrace_mode_update },
+	game->modes[2] = (Mode) { .compute_filename = "shaders/pathtrace.comp",     .grid_length = 16, .visible_dimensions = 3, .init = pathtrace_mode_init,     .update = pathtrace_mode_update },
 	game->modes[3] = (Mode) { .compute_filename = "shaders/battleship_3d.comp", .grid_length = 4,  .visible_dimensions = 3, .init = battleship_3d_mode_init, .update = battleship_3d_mode_update },
 	mode_init(&game->modes[game->current_mode], game->mode_data);
 }
@@ -125,6 +152,25 @@ void game_loop(Game* game, Input* input, float dt)
 
 	game->modes[game->current_mode].update(game->mode_data, input, dt);
 
+	Mode* mode = &game->modes[game->current_mode];
+	if(input->change_renderer.pressed)
+	{
+		mode->renderer = (mode->renderer + 1) % VOXEL_RENDERERS_COUNT;
+	}
+	if(input->change_precision.pressed)
+	{
+		mode->field_precision = (mode->field_precision + 1) % FIELD_PRECISIONS_COUNT;
+	}
+
+	if(input->grow_grid.pressed && mode->grid_length < GRID_MAX_LENGTH)
+	{
+		mode->grid_length *= 2;
+	}
+	if(input->shrink_grid.pressed && mode->grid_length > GRID_MIN_LENGTH)
+	{
+		mode->grid_length /= 2;
+	}
+
 	if(input->change_mode.held)
 	{
 		uint8_t tmp_wrap = MODES_TMP_COUNT - 1; // TODO - stop having to change this
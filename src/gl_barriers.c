@@ -0,0 +1,74 @@
+// Tracks which resources have shader writes that no glMemoryBarrier has made
+// visible yet, so each pass only waits on what it actually reads. A pass
+// declares what it reads, with the barrier bits for how it reads it, flushes,
+// then runs and declares what it wrote. Nothing is issued when everything it
+// reads is already visible.
+//
+// glMemoryBarrier waits on every earlier write, tracked or not, so where a
+// barrier lands matters as much as its bits. Passes expected to overlap must
+// have everything the passes after them read flushed before they're issued,
+// see gl_loop.
+//
+// Barriers issued and elided are counted per frame and kept from the last
+// frame for display, as with GlState.
+
+#define GL_BARRIER_RESOURCES_MAX 16
+
+typedef struct
+{
+	// The barrier bits not issued since each resource was last written.
+	uint32_t pending[GL_BARRIER_RESOURCES_MAX];
+
+	// Bits declared by gl_barriers_read since the last flush.
+	uint32_t required;
+
+	uint32_t barriers_issued;
+	uint32_t barriers_elided;
+	uint32_t last_frame_barriers_issued;
+	uint32_t last_frame_barriers_elided;
+} GlBarriers;
+
+void gl_barriers_init(GlBarriers* barriers)
+{
+	memset(barriers, 0, sizeof(GlBarriers));
+}
+
+void gl_barriers_end_frame(GlBarriers* barriers)
+{
+	barriers->last_frame_barriers_issued = barriers->barriers_issued;
+	barriers->last_frame_barriers_elided = barriers->barriers_elided;
+	barriers->barriers_issued = 0;
+	barriers->barriers_elided = 0;
+}
+
+// After a pass has written resource from a shader.
+void gl_barriers_write(GlBarriers* barriers, uint32_t resource)
+{
+	barriers->pending[resource] = GL_ALL_BARRIER_BITS;
+}
+
+// Before a pass reads resource in the ways given by barrier_bits. Takes effect
+// on the next gl_barriers_flush.
+void gl_barriers_read(GlBarriers* barriers, uint32_t resource, uint32_t barrier_bits)
+{
+	barriers->required |= barriers->pending[resource] & barrier_bits;
+}
+
+// Issues one barrier covering every read declared since the last flush, if
+// any of them need it.
+void gl_barriers_flush(GlBarriers* barriers)
+{
+	if(barriers->required == 0)
+	{
+		barriers->barriers_elided++;
+		return;
+	}
+
+	glMemoryBarrier(barriers->required);
+	for(uint32_t i = 0; i < GL_BARRIER_RESOURCES_MAX; i++)
+	{
+		barriers->pending[i] &= ~barriers->required;
+	}
+	barriers->required = 0;
+	barriers->barriers_issued++;
+}
@@ -0,0 +1,125 @@
+// Instanced draws sharing a program, gathered over a frame and issued as one
+// glMultiDrawArraysIndirect. Every draw carries its own parameters, a struct
+// of the batch's params_size in an SSBO the vertex shader indexes with
+// gl_DrawIDARB, so another view or overlay is another draw in the batch rather
+// than another draw call.
+//
+// A draw's command either comes from the CPU or is copied in on the GPU from
+// a buffer the GPU filled, like the voxel draws written by compaction. Both
+// the commands and the parameters go through the upload ring.
+//
+// VOLATILE - DRAW_PARAMS_SSBO_SLOT must match the binding of in_draw_params in
+// the batched vertex shaders.
+
+#define GL_DRAW_BATCH_MAX_DRAWS 16
+#define GL_DRAW_BATCH_MAX_PARAMS_SIZE 128
+
+#define DRAW_PARAMS_SSBO_SLOT 9
+
+typedef struct
+{
+	ProgramHandle program;
+	VertexArrayHandle vertex_array;
+	GLenum primitive;
+
+	// Must match the std430 array stride of the shader's parameter struct.
+	uint32_t params_size;
+
+	uint32_t draws_count;
+	DrawArraysIndirectCommand commands[GL_DRAW_BATCH_MAX_DRAWS];
+	uint8_t params[GL_DRAW_BATCH_MAX_DRAWS * GL_DRAW_BATCH_MAX_PARAMS_SIZE];
+
+	// For commands filled on the GPU, where to copy them from. Commands from
+	// the CPU have no source.
+	bool command_on_gpu[GL_DRAW_BATCH_MAX_DRAWS];
+	BufferHandle command_sources[GL_DRAW_BATCH_MAX_DRAWS];
+	int64_t command_source_offsets[GL_DRAW_BATCH_MAX_DRAWS];
+} GlDrawBatch;
+
+// What one flush of a batch takes from the upload ring, at most.
+uint32_t gl_draw_batch_upload_size(uint32_t params_size)
+{
+	return GL_DRAW_BATCH_MAX_DRAWS * (sizeof(DrawArraysIndirectCommand) + params_size);
+}
+
+void gl_draw_batch_init(GlDrawBatch* batch, ProgramHandle program, VertexArrayHandle vertex_array, GLenum primitive, uint32_t params_size)
+{
+	if(params_size > GL_DRAW_BATCH_MAX_PARAMS_SIZE)
+	{
+		panic();
+	}
+
+	batch->program = program;
+	batch->vertex_array = vertex_array;
+	batch->primitive = primitive;
+	batch->params_size = params_size;
+	batch->draws_count = 0;
+}
+
+// Returns the index of the draw, which is gl_DrawIDARB in the shader.
+uint32_t gl_draw_batch_push(GlDrawBatch* batch, void* params)
+{
+	if(batch->draws_count >= GL_DRAW_BATCH_MAX_DRAWS)
+	{
+		panic();
+	}
+
+	uint32_t draw = batch->draws_count;
+	batch->draws_count++;
+	memcpy(&batch->params[draw * batch->params_size], params, batch->params_size);
+	batch->command_on_gpu[draw] = false;
+
+	return draw;
+}
+
+uint32_t gl_draw_batch_add(GlDrawBatch* batch, DrawArraysIndirectCommand* command, void* params)
+{
+	uint32_t draw = gl_draw_batch_push(batch, params);
+	batch->commands[draw] = *command;
+
+	return draw;
+}
+
+// The command is read from source when the batch is flushed, so by then any
+// shader writes to it must be visible to buffer copies, see gl_barriers.c.
+uint32_t gl_draw_batch_add_indirect(GlDrawBatch* batch, BufferHandle source, int64_t source_offset, void* params)
+{
+	uint32_t draw = gl_draw_batch_push(batch, params);
+	memset(&batch->commands[draw], 0, sizeof(DrawArraysIndirectCommand));
+	batch->command_on_gpu[draw] = true;
+	batch->command_sources[draw] = source;
+	batch->command_source_offsets[draw] = source_offset;
+
+	return draw;
+}
+
+// Issues every draw added since the last flush, if there are any, in the order
+// they were added.
+void gl_draw_batch_flush(GlDrawBatch* batch, GlResources* resources, GlState* state, UploadRing* ring)
+{
+	if(batch->draws_count == 0)
+	{
+		return;
+	}
+
+	uint32_t commands_size = sizeof(DrawArraysIndirectCommand) * batch->draws_count;
+	uint32_t commands_offset = upload_ring_push(ring, batch->commands, commands_size);
+	uint32_t params_offset = upload_ring_push(ring, batch->params, batch->params_size * batch->draws_count);
+
+	for(uint32_t i = 0; i < batch->draws_count; i++)
+	{
+		if(batch->command_on_gpu[i])
+		{
+			uint32_t command_offset = commands_offset + i * sizeof(DrawArraysIndirectCommand);
+			glCopyNamedBufferSubData(gl_buffer(resources, batch->command_sources[i]), ring->buffer, batch->command_source_offsets[i], command_offset, sizeof(DrawArraysIndirectCommand));
+		}
+	}
+
+	gl_state_use_program(state, gl_program(resources, batch->program));
+	gl_state_bind_vertex_array(state, gl_vertex_array(resources, batch->vertex_array));
+	gl_state_bind_buffer_range(state, GL_SHADER_STORAGE_BUFFER, DRAW_PARAMS_SSBO_SLOT, ring->buffer, params_offset, batch->params_size * batch->draws_count);
+	gl_state_bind_buffer(state, GL_DRAW_INDIRECT_BUFFER, ring->buffer);
+	glMultiDrawArraysIndirect(batch->primitive, (void*)(uintptr_t)commands_offset, batch->draws_count, 0);
+
+	batch->draws_count = 0;
+}
@@ -0,0 +1,172 @@
+// Pools of the buffers, programs and vertex arrays opengl.c creates, handed
+// out as typed handles rather than raw GL names. Everything is created with
+// direct state access, so nothing has to be bound to be set up, and buffers
+// get immutable storage.
+//
+// A handle stays valid for the life of the context. The GL name behind it can
+// change, as immutable storage can't be resized and so is instead replaced,
+// see gl_reallocate_buffer, and programs are replaced as their shaders are
+// edited, see gl_replace_program.
+
+#define GL_BUFFERS_MAX 32
+#define GL_PROGRAMS_MAX 64
+#define GL_VERTEX_ARRAYS_MAX 8
+
+typedef struct
+{
+	uint16_t index;
+} BufferHandle;
+
+typedef struct
+{
+	uint16_t index;
+} ProgramHandle;
+
+typedef struct
+{
+	uint16_t index;
+} VertexArrayHandle;
+
+typedef struct
+{
+	uint32_t name;
+	int64_t size;
+	uint32_t flags;
+} GlBuffer;
+
+typedef struct
+{
+	GlBuffer buffers[GL_BUFFERS_MAX];
+	uint32_t buffers_count;
+	int64_t buffer_bytes;
+
+	uint32_t programs[GL_PROGRAMS_MAX];
+	uint32_t programs_count;
+
+	uint32_t vertex_arrays[GL_VERTEX_ARRAYS_MAX];
+	uint32_t vertex_arrays_count;
+} GlResources;
+
+void gl_resources_init(GlResources* resources)
+{
+	memset(resources, 0, sizeof(GlResources));
+}
+
+// Buffers
+
+// flags are those of glBufferStorage. Without GL_DYNAMIC_STORAGE_BIT the
+// contents can only be set here, through data, or on the GPU. data may be
+// NULL, leaving them undefined.
+void gl_buffer_storage(GlBuffer* buffer, int64_t size, void* data, uint32_t flags)
+{
+	glCreateBuffers(1, &buffer->name);
+	glNamedBufferStorage(buffer->name, size, data, flags);
+	buffer->size = size;
+	buffer->flags = flags;
+}
+
+BufferHandle gl_create_buffer(GlResources* resources, int64_t size, void* data, uint32_t flags)
+{
+	if(resources->buffers_count >= GL_BUFFERS_MAX)
+	{
+		panic();
+	}
+
+	BufferHandle handle = { .index = resources->buffers_count };
+	resources->buffers_count++;
+
+	gl_buffer_storage(&resources->buffers[handle.index], size, data, flags);
+	resources->buffer_bytes += size;
+
+	return handle;
+}
+
+// Replaces the buffer's storage, losing its contents. Every binding of the old
+// buffer is gone with it, so it must be bound again.
+void gl_reallocate_buffer(GlResources* resources, GlState* state, BufferHandle handle, int64_t size, void* data, uint32_t flags)
+{
+	GlBuffer* buffer = &resources->buffers[handle.index];
+	gl_state_forget_buffer(state, buffer->name);
+	glDeleteBuffers(1, &buffer->name);
+	resources->buffer_bytes -= buffer->size;
+
+	gl_buffer_storage(buffer, size, data, flags);
+	resources->buffer_bytes += size;
+}
+
+uint32_t gl_buffer(GlResources* resources, BufferHandle handle)
+{
+	return resources->buffers[handle.index].name;
+}
+
+int64_t gl_buffer_size(GlResources* resources, BufferHandle handle)
+{
+	return resources->buffers[handle.index].size;
+}
+
+// Programs
+
+// Takes ownership of an already linked program.
+ProgramHandle gl_add_program(GlResources* resources, uint32_t program)
+{
+	if(resources->programs_count >= GL_PROGRAMS_MAX)
+	{
+		panic();
+	}
+
+	ProgramHandle handle = { .index = resources->programs_count };
+	resources->programs_count++;
+	resources->programs[handle.index] = program;
+
+	return handle;
+}
+
+// Takes ownership of program, an already linked replacement for the one
+// behind handle, which is deleted. Anything set on the old program, like
+// uniform block bindings, must be set again.
+void gl_replace_program(GlResources* resources, GlState* state, ProgramHandle handle, uint32_t program)
+{
+	uint32_t* old_program = &resources->programs[handle.index];
+	gl_state_forget_program(state, *old_program);
+	glDeleteProgram(*old_program);
+	*old_program = program;
+}
+
+uint32_t gl_program(GlResources* resources, ProgramHandle handle)
+{
+	return resources->programs[handle.index];
+}
+
+// Vertex arrays
+
+// Starts out with no attributes, which is all that's needed to draw something
+// generated from the vertex id.
+VertexArrayHandle gl_create_vertex_array(GlResources* resources)
+{
+	if(resources->vertex_arrays_count >= GL_VERTEX_ARRAYS_MAX)
+	{
+		panic();
+	}
+
+	VertexArrayHandle handle = { .index = resources->vertex_arrays_count };
+	resources->vertex_arrays_count++;
+	glCreateVertexArrays(1, &resources->vertex_arrays[handle.index]);
+
+	return handle;
+}
+
+// Feeds attribute index components floats, offset bytes into each stride
+// byte vertex of buffer. Each attribute gets the binding of the same index.
+void gl_vertex_array_float_attribute(GlResources* resources, VertexArrayHandle handle, uint32_t index, uint32_t components, uint32_t offset, BufferHandle buffer, uint32_t stride)
+{
+	uint32_t vertex_array = resources->vertex_arrays[handle.index];
+	glVertexArrayVertexBuffer(vertex_array, index, gl_buffer(resources, buffer), 0, stride);
+	glEnableVertexArrayAttrib(vertex_array, index);
+	glVertexArrayAttribFormat(vertex_array, index, components, GL_FLOAT, GL_FALSE, offset);
+	glVertexArrayAttribBinding(vertex_array, index, index);
+}
+
+uint32_t gl_vertex_array(GlResources* resources, VertexArrayHandle handle)
+{
+	return resources->vertex_arrays[handle.index];
+}
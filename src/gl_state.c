@@ -0,0 +1,267 @@
+// A cache of the GL binding state, sitting in front of the bind calls made by
+// opengl.c so binding what's already bound costs nothing. Every bind of
+// something the cache tracks must go through here or the cache goes stale.
+//
+// Calls issued and elided are counted per frame and kept from the last frame
+// for display.
+
+#define GL_STATE_UNIFORM_SLOTS 8
+#define GL_STATE_STORAGE_SLOTS 16
+#define GL_STATE_TEXTURE_UNITS 8
+#define GL_STATE_IMAGE_UNITS 4
+
+// The generic (non-indexed) buffer targets that get bound.
+#define GL_STATE_BUFFER_TARGETS 5
+
+typedef struct
+{
+	uint32_t buffer;
+	int64_t offset;
+	int64_t size;
+} GlBufferRange;
+
+typedef struct
+{
+	uint32_t program;
+	uint32_t vertex_array;
+	uint32_t framebuffer;
+	bool depth_test;
+
+	uint32_t buffers[GL_STATE_BUFFER_TARGETS];
+	GlBufferRange uniform_buffers[GL_STATE_UNIFORM_SLOTS];
+	GlBufferRange storage_buffers[GL_STATE_STORAGE_SLOTS];
+
+	// 2D and 3D per unit.
+	uint32_t active_texture_unit;
+	uint32_t textures[GL_STATE_TEXTURE_UNITS][2];
+	uint32_t images[GL_STATE_IMAGE_UNITS];
+
+	uint32_t calls_issued;
+	uint32_t calls_elided;
+	uint32_t last_frame_calls_issued;
+	uint32_t last_frame_calls_elided;
+} GlState;
+
+// Expects the GL state to be at its defaults, besides the depth test.
+void gl_state_init(GlState* state, bool depth_test)
+{
+	memset(state, 0, sizeof(GlState));
+	state->depth_test = depth_test;
+}
+
+void gl_state_end_frame(GlState* state)
+{
+	state->last_frame_calls_issued = state->calls_issued;
+	state->last_frame_calls_elided = state->calls_elided;
+	state->calls_issued = 0;
+	state->calls_elided = 0;
+}
+
+// Returns whether the call is needed, counting it either way.
+bool gl_state_changed(GlState* state, bool changed)
+{
+	if(changed)
+	{
+		state->calls_issued++;
+	}
+	else
+	{
+		state->calls_elided++;
+	}
+	return changed;
+}
+
+uint32_t gl_state_buffer_target_index(GLenum target)
+{
+	switch(target)
+	{
+		case GL_ARRAY_BUFFER: return 0;
+		case GL_UNIFORM_BUFFER: return 1;
+		case GL_SHADER_STORAGE_BUFFER: return 2;
+		case GL_DRAW_INDIRECT_BUFFER: return 3;
+		case GL_DISPATCH_INDIRECT_BUFFER: return 4;
+		default: break;
+	}
+	panic();
+}
+
+void gl_state_use_program(GlState* state, uint32_t program)
+{
+	if(gl_state_changed(state, state->program != program))
+	{
+		glUseProgram(program);
+		state->program = program;
+	}
+}
+
+void gl_state_bind_vertex_array(GlState* state, uint32_t vertex_array)
+{
+	if(gl_state_changed(state, state->vertex_array != vertex_array))
+	{
+		glBindVertexArray(vertex_array);
+		state->vertex_array = vertex_array;
+	}
+}
+
+void gl_state_bind_framebuffer(GlState* state, uint32_t framebuffer)
+{
+	if(gl_state_changed(state, state->framebuffer != framebuffer))
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		state->framebuffer = framebuffer;
+	}
+}
+
+void gl_state_set_depth_test(GlState* state, bool depth_test)
+{
+	if(gl_state_changed(state, state->depth_test != depth_test))
+	{
+		if(depth_test)
+		{
+			glEnable(GL_DEPTH_TEST);
+		}
+		else
+		{
+			glDisable(GL_DEPTH_TEST);
+		}
+		state->depth_test = depth_test;
+	}
+}
+
+void gl_state_bind_buffer(GlState* state, GLenum target, uint32_t buffer)
+{
+	uint32_t* bound = &state->buffers[gl_state_buffer_target_index(target)];
+	if(gl_state_changed(state, *bound != buffer))
+	{
+		glBindBuffer(target, buffer);
+		*bound = buffer;
+	}
+}
+
+// A size of 0 binds the whole buffer, as with glBindBufferBase. Either way
+// this also binds the generic target, as GL does.
+void gl_state_bind_buffer_range(GlState* state, GLenum target, uint32_t index, uint32_t buffer, int64_t offset, int64_t size)
+{
+	GlBufferRange* bound;
+	if(target == GL_UNIFORM_BUFFER && index < GL_STATE_UNIFORM_SLOTS)
+	{
+		bound = &state->uniform_buffers[index];
+	}
+	else if(target == GL_SHADER_STORAGE_BUFFER && index < GL_STATE_STORAGE_SLOTS)
+	{
+		bound = &state->storage_buffers[index];
+	}
+	else
+	{
+		panic();
+	}
+
+	bool changed = bound->buffer != buffer || bound->offset != offset || bound->size != size;
+	if(gl_state_changed(state, changed))
+	{
+		if(size == 0)
+		{
+			glBindBufferBase(target, index, buffer);
+		}
+		else
+		{
+			glBindBufferRange(target, index, buffer, offset, size);
+		}
+		bound->buffer = buffer;
+		bound->offset = offset;
+		bound->size = size;
+		state->buffers[gl_state_buffer_target_index(target)] = buffer;
+	}
+}
+
+void gl_state_bind_buffer_base(GlState* state, GLenum target, uint32_t index, uint32_t buffer)
+{
+	gl_state_bind_buffer_range(state, target, index, buffer, 0, 0);
+}
+
+// For a buffer about to be deleted, which unbinds it from everything. Its name
+// may well be handed out again.
+void gl_state_forget_buffer(GlState* state, uint32_t buffer)
+{
+	for(uint32_t i = 0; i < GL_STATE_BUFFER_TARGETS; i++)
+	{
+		if(state->buffers[i] == buffer)
+		{
+			state->buffers[i] = 0;
+		}
+	}
+	for(uint32_t i = 0; i < GL_STATE_UNIFORM_SLOTS; i++)
+	{
+		if(state->uniform_buffers[i].buffer == buffer)
+		{
+			memset(&state->uniform_buffers[i], 0, sizeof(GlBufferRange));
+		}
+	}
+	for(uint32_t i = 0; i < GL_STATE_STORAGE_SLOTS; i++)
+	{
+		if(state->storage_buffers[i].buffer == buffer)
+		{
+			memset(&state->storage_buffers[i], 0, sizeof(GlBufferRange));
+		}
+	}
+}
+
+// For a texture about to be deleted, as with gl_state_forget_buffer.
+void gl_state_forget_texture(GlState* state, uint32_t texture)
+{
+	for(uint32_t i = 0; i < GL_STATE_TEXTURE_UNITS; i++)
+	{
+		for(uint32_t j = 0; j < 2; j++)
+		{
+			if(state->textures[i][j] == texture)
+			{
+				state->textures[i][j] = 0;
+			}
+		}
+	}
+	for(uint32_t i = 0; i < GL_STATE_IMAGE_UNITS; i++)
+	{
+		if(state->images[i] == texture)
+		{
+			state->images[i] = 0;
+		}
+	}
+}
+
+// Leaves unit active even when the texture was already bound, since textures
+// are also bound to be edited with the non-DSA calls, which go through the
+// active unit.
+void gl_state_bind_texture(GlState* state, uint32_t unit, GLenum target, uint32_t texture)
+{
+	if(gl_state_changed(state, state->active_texture_unit != unit))
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		state->active_texture_unit = unit;
+	}
+
+	uint32_t* bound = &state->textures[unit][target == GL_TEXTURE_3D ? 1 : 0];
+	if(gl_state_changed(state, *bound != texture))
+	{
+		glBindTexture(target, texture);
+		*bound = texture;
+	}
+}
+
+// Always binds the whole, layered, first level.
+void gl_state_bind_image(GlState* state, uint32_t unit, uint32_t texture, GLenum access, GLenum format)
+{
+	if(gl_state_changed(state, state->images[unit] != texture))
+	{
+		glBindImageTexture(unit, texture, 0, GL_TRUE, 0, access, format);
+		state->images[unit] = texture;
+	}
+}
+
+// For a program about to be deleted, as with gl_state_forget_buffer.
+void gl_state_forget_program(GlState* state, uint32_t program)
+{
+	if(state->program == program)
+	{
+		state->program = 0;
+	}
+}
@@ -1,5 +1,5 @@
 // VOLATILE - this must match the number of buttons defined in input_state.
-#define INPUT_BUTTONS_LEN 20
+#define INPUT_BUTTONS_LEN 24
 
 typedef struct
 {
@@ -43,6 +43,10 @@ typedef struct
         	InputButton move_down_d;
         	InputButton change_mode;
         	InputButton bang_center;
+        	InputButton change_renderer;
+        	InputButton grow_grid;
+        	InputButton shrink_grid;
+        	InputButton change_precision;
     	};
 	};
 } Input;
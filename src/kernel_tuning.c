@@ -0,0 +1,119 @@
+// Workgroup sizes chosen for the mode kernels by --tune, see
+// gl_tune_mode_kernels, kept on disk per GL_RENDERER since what's fastest
+// depends on the GPU. One line per kernel and grid length:
+//
+//     shaders/wave.comp 16 2 2 1
+//
+// being the kernel, the grid length, then the workgroup size in bricks along
+// x, y and z. Kernels and grid lengths not listed, or everything if there's
+// no file for the renderer, get one brick per workgroup.
+
+#define KERNEL_TUNING_ENTRIES_MAX 256
+
+typedef struct
+{
+	char kernel[32];
+	uint32_t grid_length;
+	uint8_t group_size[3];
+} KernelTuningEntry;
+
+typedef struct
+{
+	KernelTuningEntry entries[KERNEL_TUNING_ENTRIES_MAX];
+	uint32_t entries_count;
+} KernelTuning;
+
+void kernel_tuning_filename(char* filename)
+{
+	char* renderer = (char*)glGetString(GL_RENDERER);
+	uint64_t hash = hash_fnv1a(HASH_FNV1A_BASIS, renderer, strlen(renderer) + 1);
+	sprintf(filename, PROGRAM_CACHE_DIRECTORY "/tuning_%016llx.txt", (unsigned long long)hash);
+}
+
+void kernel_tuning_load(KernelTuning* tuning)
+{
+	tuning->entries_count = 0;
+
+	char filename[64];
+	kernel_tuning_filename(filename);
+	FILE* file = fopen(filename, "r");
+	if(file == NULL)
+	{
+		return;
+	}
+
+	KernelTuningEntry entry;
+	uint32_t group_size[3];
+	while(tuning->entries_count < KERNEL_TUNING_ENTRIES_MAX
+		&& fscanf(file, "%31s %u %u %u %u", entry.kernel, &entry.grid_length, &group_size[0], &group_size[1], &group_size[2]) == 5)
+	{
+		for(uint32_t i = 0; i < 3; i++)
+		{
+			entry.group_size[i] = group_size[i];
+		}
+		tuning->entries[tuning->entries_count] = entry;
+		tuning->entries_count++;
+	}
+	fclose(file);
+}
+
+void kernel_tuning_save(KernelTuning* tuning)
+{
+	char filename[64];
+	kernel_tuning_filename(filename);
+	FILE* file = fopen(filename, "w");
+	if(file == NULL)
+	{
+		printf("couldn't write %s\n", filename);
+		return;
+	}
+
+	for(uint32_t i = 0; i < tuning->entries_count; i++)
+	{
+		KernelTuningEntry* entry = &tuning->entries[i];
+		fprintf(file, "%s %u %u %u %u\n", entry->kernel, entry->grid_length, entry->group_size[0], entry->group_size[1], entry->group_size[2]);
+	}
+	fclose(file);
+	printf("wrote %s\n", filename);
+}
+
+// Fills group_size and returns true if the kernel was tuned for grid_length.
+bool kernel_tuning_find(KernelTuning* tuning, char* kernel, uint32_t grid_length, uint8_t* group_size)
+{
+	for(uint32_t i = 0; i < tuning->entries_count; i++)
+	{
+		KernelTuningEntry* entry = &tuning->entries[i];
+		if(entry->grid_length == grid_length && strcmp(entry->kernel, kernel) == 0)
+		{
+			memcpy(group_size, entry->group_size, 3);
+			return true;
+		}
+	}
+	return false;
+}
+
+void kernel_tuning_set(KernelTuning* tuning, char* kernel, uint32_t grid_length, uint8_t* group_size)
+{
+	KernelTuningEntry* entry = NULL;
+	for(uint32_t i = 0; i < tuning->entries_count; i++)
+	{
+		if(tuning->entries[i].grid_length == grid_length && strcmp(tuning->entries[i].kernel, kernel) == 0)
+		{
+			entry = &tuning->entries[i];
+		}
+	}
+
+	if(entry == NULL)
+	{
+		if(tuning->entries_count >= KERNEL_TUNING_ENTRIES_MAX)
+		{
+			panic();
+		}
+		entry = &tuning->entries[tuning->entries_count];
+		tuning->entries_count++;
+		strncpy(entry->kernel, kernel, sizeof(entry->kernel) - 1);
+		entry->kernel[sizeof(entry->kernel) - 1] = '\0';
+		entry->grid_length = grid_length;
+	}
+	memcpy(entry->group_size, group_size, 3);
+}
@@ -0,0 +1,206 @@
+// Compares the linear and Morton field layouts, see field_layout.glsl, by
+// running the field reads of the compaction pass through a simulated cache.
+// compact.comp reads the field in instance order, which is the back to front
+// ordering for the camera, so how well a layout does depends on where the
+// camera is. Misses are counted for each of the 48 orderings and reported per
+// camera octant, summed over its 6 axis orders, then per axis order, summed
+// over the 8 octants.
+//
+// Also reported is how many cache lines a single brick touches, which is what
+// the mode kernels write to each frame.
+//
+// Run with --bench-layout. Needs no window or GL context.
+
+// GLSL's, for morton.glsl.
+typedef unsigned int uint;
+#include "shaders/morton.glsl"
+
+// A small set associative cache with LRU replacement, about the size of a GPU
+// L1. Lines hold 16 voxels of an R32F field.
+#define LAYOUT_BENCH_LINE_SIZE 64
+#define LAYOUT_BENCH_SETS 64
+#define LAYOUT_BENCH_WAYS 4
+
+#define LAYOUT_BENCH_GRID_LENGTHS_COUNT 3
+
+typedef struct
+{
+	uint64_t tags[LAYOUT_BENCH_SETS][LAYOUT_BENCH_WAYS];
+	uint64_t last_used[LAYOUT_BENCH_SETS][LAYOUT_BENCH_WAYS];
+	uint64_t time;
+	uint64_t misses;
+} LayoutBenchCache;
+
+void layout_bench_cache_reset(LayoutBenchCache* cache)
+{
+	// No line is ever tagged with all ones, so everything starts out empty.
+	memset(cache->tags, 0xFF, sizeof(cache->tags));
+	memset(cache->last_used, 0, sizeof(cache->last_used));
+	cache->time = 0;
+	cache->misses = 0;
+}
+
+void layout_bench_cache_read(LayoutBenchCache* cache, uint64_t address)
+{
+	uint64_t line = address / LAYOUT_BENCH_LINE_SIZE;
+	uint32_t set = line % LAYOUT_BENCH_SETS;
+	cache->time++;
+
+	uint32_t oldest = 0;
+	for(uint32_t way = 0; way < LAYOUT_BENCH_WAYS; way++)
+	{
+		if(cache->tags[set][way] == line)
+		{
+			cache->last_used[set][way] = cache->time;
+			return;
+		}
+		if(cache->last_used[set][way] < cache->last_used[set][oldest])
+		{
+			oldest = way;
+		}
+	}
+
+	cache->misses++;
+	cache->tags[set][oldest] = line;
+	cache->last_used[set][oldest] = cache->time;
+}
+
+// The field index of voxel, as field_index in field_layout.glsl.
+uint32_t layout_bench_field_index(uint32_t* voxel, uint32_t grid_length, uint8_t field_layout)
+{
+	if(field_layout == FIELD_LAYOUT_MORTON)
+	{
+		return morton_encode(voxel[0], voxel[1], voxel[2]);
+	}
+	return voxel[2] * grid_length * grid_length + voxel[1] * grid_length + voxel[0];
+}
+
+// Cache misses for reading the whole field in the order of permutation.
+uint64_t layout_bench_ordering_misses(LayoutBenchCache* cache, uint32_t permutation, uint32_t grid_length, uint8_t field_layout)
+{
+	layout_bench_cache_reset(cache);
+
+	uint32_t instance[3];
+	uint32_t voxel[3];
+	for(instance[2] = 0; instance[2] < grid_length; instance[2]++)
+	{
+		for(instance[1] = 0; instance[1] < grid_length; instance[1]++)
+		{
+			for(instance[0] = 0; instance[0] < grid_length; instance[0]++)
+			{
+				voxel_sort_voxel(permutation, grid_length, instance, voxel);
+				uint32_t index = layout_bench_field_index(voxel, grid_length, field_layout);
+				layout_bench_cache_read(cache, (uint64_t)index * sizeof(float));
+			}
+		}
+	}
+
+	return cache->misses;
+}
+
+// Cache lines touched by the first brick of the grid.
+uint32_t layout_bench_brick_lines(uint32_t grid_length, uint8_t field_layout)
+{
+	LayoutBenchCache cache;
+	layout_bench_cache_reset(&cache);
+
+	uint32_t voxel[3];
+	for(voxel[2] = 0; voxel[2] < 4; voxel[2]++)
+	{
+		for(voxel[1] = 0; voxel[1] < 4; voxel[1]++)
+		{
+			for(voxel[0] = 0; voxel[0] < 4; voxel[0]++)
+			{
+				uint32_t index = layout_bench_field_index(voxel, grid_length, field_layout);
+				layout_bench_cache_read(&cache, (uint64_t)index * sizeof(float));
+			}
+		}
+	}
+
+	return cache.misses;
+}
+
+void layout_bench_run()
+{
+	static LayoutBenchCache cache;
+	uint32_t grid_lengths[LAYOUT_BENCH_GRID_LENGTHS_COUNT] = { 16, 64, 128 };
+
+	printf("field layout cache behavior, %u byte lines, %u sets of %u ways\n", LAYOUT_BENCH_LINE_SIZE, LAYOUT_BENCH_SETS, LAYOUT_BENCH_WAYS);
+	printf("misses per 1000 reads of the compaction walk\n");
+
+	for(uint32_t i = 0; i < LAYOUT_BENCH_GRID_LENGTHS_COUNT; i++)
+	{
+		uint32_t grid_length = grid_lengths[i];
+		uint64_t grid_volume = grid_length * grid_length * grid_length;
+
+		printf("\n%u^3, lines per brick: linear %u, morton %u\n", grid_length,
+			layout_bench_brick_lines(grid_length, FIELD_LAYOUT_LINEAR),
+			layout_bench_brick_lines(grid_length, FIELD_LAYOUT_MORTON));
+
+		uint64_t misses[SORT_PERMUTATIONS_COUNT][2];
+		uint64_t total_misses[2] = { 0, 0 };
+		for(uint32_t permutation = 0; permutation < SORT_PERMUTATIONS_COUNT; permutation++)
+		{
+			for(uint8_t field_layout = 0; field_layout < 2; field_layout++)
+			{
+				misses[permutation][field_layout] = layout_bench_ordering_misses(&cache, permutation, grid_length, field_layout);
+				total_misses[field_layout] += misses[permutation][field_layout];
+			}
+		}
+
+		// Octant bits are set for the axes the camera is on the negative side of.
+		printf("octant   linear  morton\n");
+		for(uint32_t octant = 0; octant < 8; octant++)
+		{
+			uint64_t octant_misses[2] = { 0, 0 };
+			for(uint32_t axis_order = 0; axis_order < 6; axis_order++)
+			{
+				octant_misses[0] += misses[axis_order * 8 + octant][0];
+				octant_misses[1] += misses[axis_order * 8 + octant][1];
+			}
+
+			printf("%c%c%c     %7.1f %7.1f\n",
+				(octant & 1) ? '-' : '+', (octant & 2) ? '-' : '+', (octant & 4) ? '-' : '+',
+				octant_misses[0] * 1000.0 / (grid_volume * 6),
+				octant_misses[1] * 1000.0 / (grid_volume * 6));
+		}
+
+		// Named slice axis first, then row, then unit.
+		printf("order    linear  morton\n");
+		for(uint32_t axis_order = 0; axis_order < 6; axis_order++)
+		{
+			uint64_t order_misses[2] = { 0, 0 };
+			for(uint32_t octant = 0; octant < 8; octant++)
+			{
+				order_misses[0] += misses[axis_order * 8 + octant][0];
+				order_misses[1] += misses[axis_order * 8 + octant][1];
+			}
+
+			uint32_t instance[3] = { 0, 0, 0 };
+			uint32_t voxel[3];
+			char name[4] = "   ";
+			for(uint32_t instance_axis = 0; instance_axis < 3; instance_axis++)
+			{
+				// Which voxel axis this instance axis walks along.
+				instance[instance_axis] = 1;
+				voxel_sort_voxel(axis_order * 8, grid_length, instance, voxel);
+				instance[instance_axis] = 0;
+				for(uint32_t axis = 0; axis < 3; axis++)
+				{
+					if(voxel[axis] == 1)
+					{
+						name[2 - instance_axis] = "xyz"[axis];
+					}
+				}
+			}
+
+			printf("%s     %7.1f %7.1f\n", name,
+				order_misses[0] * 1000.0 / (grid_volume * 8),
+				order_misses[1] * 1000.0 / (grid_volume * 8));
+		}
+
+		printf("all     %7.1f %7.1f\n",
+			total_misses[0] * 1000.0 / (grid_volume * SORT_PERMUTATIONS_COUNT),
+			total_misses[1] * 1000.0 / (grid_volume * SORT_PERMUTATIONS_COUNT));
+	}
+}
@@ -20,10 +20,123 @@
 #include "stb/stb_image.h"
 
 #include "voxel_sort.c"
+#include "upload_ring.c"
+#include "gl_state.c"
+#include "gl_resources.c"
+#include "gl_barriers.c"
+#include "program_cache.c"
+#include "shader_watch.c"
+#include "kernel_tuning.c"
 
-#define GRID_MAX_VOLUME 32768
 #define TEXT_MAX_CHARS 2048
 
+// Dirty runs of text closer than this many chars are uploaded as one.
+#define TEXT_DIRTY_GAP 8
+
+// VOLATILE - these must match the binding qualifiers of the uniform blocks in
+// the shaders.
+#define UBO_SLOT_VOXEL 0
+#define UBO_SLOT_MODE 1
+
+// Including everything pulled in by #include.
+#define SHADER_SOURCE_MAX 65536
+
+// Defines for every shader, set up by gl_init from the options.
+#define SHADER_DEFINES_MAX 256
+
+// The longest defines of one variant of a program, see gl_load_program.
+#define SHADER_VARIANT_DEFINES_MAX 128
+
+// The longest compile or link error kept for display.
+#define SHADER_ERROR_MAX 512
+
+// Where the mode's color field lives, see field.glsl.
+#define FIELD_STORAGE_BUFFER 0
+#define FIELD_STORAGE_IMAGE 1
+
+// The order of the voxels in the field, see field_layout.glsl.
+#define FIELD_LAYOUT_LINEAR 0
+#define FIELD_LAYOUT_MORTON 1
+
+// VOLATILE - these must match the bindings in field.glsl.
+#define FIELD_FRONT_SSBO_SLOT 0
+#define FIELD_BACK_SSBO_SLOT 8
+#define FIELD_IMAGE_UNIT 2
+#define FIELD_TEXTURE_UNIT 3
+
+// The resources tracked by GlBarriers, see gl_barriers.c. Each of the two
+// fields is tracked on its own, from BARRIER_FIELD.
+#define BARRIER_FIELD 0
+#define BARRIER_BRICKS 2
+#define BARRIER_BRICK_DISPATCH 3
+#define BARRIER_SORT_TABLE 4
+// The visible voxels, compact blocks and voxel draws.
+#define BARRIER_COMPACTION 5
+#define BARRIER_VOLUME 6
+
+// VOLATILE - this must match local_size_x in compact.comp.
+#define COMPACT_BLOCK_SIZE 1024
+
+// Voxels with a color at or below this are skipped by the compaction pass and
+// never reach the vertex shader.
+#define VOXEL_VISIBILITY_THRESHOLD 0.0f
+
+// Enough that a query is always done by the time it comes around again.
+#define VOXEL_TIMER_QUERIES_COUNT 3
+
+// The camera facing half of a cube, see voxel.vert.
+#define VOXEL_VERTICES_COUNT 18
+
+// Past this, the sort table only holds the ordering for the current camera,
+// rebuilt whenever the camera needs another. All 48 orderings of a 64^3 grid
+// take 48MB, of a 128^3 grid 384MB.
+#define SORT_TABLE_MAX_SIZE (256 * 1024 * 1024)
+
+// Grids at least this big are drawn as splats under VOXEL_RENDERER_AUTO.
+#define SPLAT_AUTO_VOLUME (64 * 64 * 64)
+
+// How often every brick is dispatched to the mode kernel, rather than only the
+// ones that changed last frame. See gl_dispatch_mode.
+#define BRICK_REFRESH_FRAMES 60
+
+// Where each mode's program is at, see gl_update_mode_programs.
+#define MODE_PROGRAM_UNREQUESTED 0
+#define MODE_PROGRAM_BUILDING 1
+#define MODE_PROGRAM_READY 2
+#define MODE_PROGRAM_FAILED 3
+
+// Without GL_ARB_parallel_shader_compile, how many frames apart programs are
+// built ahead of their use, see gl_update_mode_programs.
+#define MODE_PROGRAM_PREFETCH_FRAMES 30
+
+// Mode kernels are built once per grid length, see gl_request_mode_program.
+// Grid lengths are powers of two, so each has its own variant.
+//
+// VOLATILE - Must cover GRID_MIN_LENGTH to GRID_MAX_LENGTH in game.c.
+#define GRID_VARIANTS_COUNT 7
+
+// The workgroup sizes mode kernels are tuned across, in bricks along x, y and
+// z, see gl_tune_mode_kernels. The first is what untuned kernels get.
+#define MODE_GROUP_SIZES_COUNT 5
+uint8_t mode_group_sizes[MODE_GROUP_SIZES_COUNT][3] = { { 1, 1, 1 }, { 2, 1, 1 }, { 2, 2, 1 }, { 2, 2, 2 }, { 4, 2, 2 } };
+
+// How many times each candidate is dispatched when tuning, after one to warm
+// up.
+#define TUNE_DISPATCHES 8
+
+// Less than this for every dispatch together, and the timer query is taken to
+// have missed the compute work, see gl_time_mode_kernel.
+#define TUNE_QUERY_MIN_NS 1000
+
+// Chosen by the platform at startup, fixed from then on.
+typedef struct
+{
+	// One of FIELD_STORAGE_*.
+	uint8_t field_storage;
+	// One of FIELD_LAYOUT_*.
+	uint8_t field_layout;
+} GlOptions;
+
 typedef struct
 {
 	int32_t index;
@@ -34,11 +147,36 @@ typedef struct
 } TextChar;
 
 #include "fill_text.c"
+#include "text_object.c"
+
+// Everything drawn over the grid, laid out once and updated as it changes.
+typedef struct
+{
+	TextObject title;
+	TextObject description;
+	TextObject space_prompt;
+	TextObject dimensions[MAX_DIMENSIONS];
+	TextObject renderer;
+	TextObject precision;
+	TextObject grid;
+	TextObject gl_stats;
+	TextObject shader_error;
+
+	// What the dimension text was last written with.
+	float dimension_values[MAX_DIMENSIONS];
+} Hud;
 
 typedef struct
 {
 	mat4 projection;
 	int32_t grid_length;
+	float visibility_threshold;
+	int32_t field_precision;
+	alignas(16) float camera_position[3];
+	mat4 inverse_projection;
+
+	// In the order and form of glm_frustum_planes.
+	vec4 frustum_planes[6];
 } VoxelUbo;
 
 typedef struct
@@ -47,90 +185,736 @@ typedef struct
 	float time;
 } ModeUbo;
 
+// Per draw parameters of the voxel batches, see gl_draw_batch.c.
+//
+// VOLATILE - this must match VoxelDraw in voxel_draw.glsl.
 typedef struct
 {
-	// this is a mat2, but must be separated like this for padding requirements.
-	alignas(16) float transform_a[2];
-	alignas(16) float transform_b[2];
-} TextUbo;
+	mat4 projection;
+	float camera_position[3];
 
+	// Converts a world space size at a clip space w of 1 to pixels.
+	float splat_scale;
+} VoxelDraw;
+
+// Per draw parameters of the text batch.
+//
+// VOLATILE - this must match TextDraw in text.vert.
 typedef struct
 {
-	int32_t map[GRID_MAX_VOLUME];
-} InstanceToVoxelSsbo;
+	// A mat2, column by column.
+	float transform[4];
+	int32_t first_char;
 
+	// Out to the std430 array stride.
+	int32_t padding;
+} TextDraw;
+
+// Matches the layout glDrawArraysIndirect expects.
 typedef struct
 {
+	uint32_t count;
+	uint32_t instance_count;
+	uint32_t first;
+	uint32_t base_instance;
+} DrawArraysIndirectCommand;
+
+// VOLATILE - this must match out_draw_buffer in compact.comp.
+typedef struct
+{
+	DrawArraysIndirectCommand cubes;
+	DrawArraysIndirectCommand splats;
+} VoxelDraws;
+
+#include "gl_draw_batch.c"
+
+// Matches the layout glDispatchComputeIndirect expects.
+typedef struct
+{
+	uint32_t num_groups_x;
+	uint32_t num_groups_y;
+	uint32_t num_groups_z;
+} DispatchIndirectCommand;
+
+// VOLATILE - this must match brick_dispatch_buffer in bricks.glsl.
+typedef struct
+{
+	uint32_t bricks_count;
+	DispatchIndirectCommand dispatch;
+	uint32_t bricks[];
+} BrickDispatch;
+
+// A program being built, see gl_begin_program.
+typedef struct
+{
+	uint32_t program;
+	uint32_t shaders[2];
+	char* filenames[2];
+	GLenum types[2];
+	uint32_t stages_count;
+	char variant_defines[SHADER_VARIANT_DEFINES_MAX];
+	uint64_t key;
+
+	// Loaded from the program cache, so already linked.
+	bool cached;
+} PendingProgram;
+
+typedef struct
+{
+	char* name;
+	uint32_t slot;
+} UniformBlockBinding;
+
+typedef struct
+{
+	GlState state;
+
+	// Every buffer, program and VAO, see gl_resources.c.
+	GlResources resources;
+	ProgramCache program_cache;
+
+	// Shader writes not yet made visible, see gl_barriers.c.
+	GlBarriers barriers;
+
 	// Textures
 	uint32_t font_texture;
+	uint32_t field_storage_textures[2];
+	uint32_t field_texture;
+	uint32_t brick_texture;
+	uint32_t oit_accumulation_texture;
+	uint32_t oit_revealage_texture;
+
+	// Framebuffers
+	uint32_t oit_framebuffer;
 	
-	// UBOs
-	uint32_t voxel_ubo_buffer;
-	uint32_t text_ubo_buffer;
-	uint32_t mode_data_ubo_buffer;
+	// Every UBO is uploaded through this each frame.
+	UploadRing upload_ring;
 
 	// SSBOs
-	uint32_t text_buffer;
-	uint32_t instance_to_voxel_buffer;
+	BufferHandle color_buffers[2];
+	BufferHandle text_buffer;
+	BufferHandle instance_to_voxel_buffer;
+	BufferHandle visible_voxel_buffer;
+	BufferHandle compact_block_buffer;
+	BufferHandle brick_buffer;
+
+	// Indirect draw/dispatch buffers
+	BufferHandle voxel_draw_buffer;
+	BufferHandle brick_dispatch_buffer;
 
 	// VAOs
-	uint32_t voxel_vao;
-	uint32_t text_vao;
+	VertexArrayHandle voxel_vao;
+	VertexArrayHandle text_vao;
+	VertexArrayHandle volume_vao;
 
 	// Raster programs
-	uint32_t voxel_program;
-	uint32_t text_program;
+	ProgramHandle voxel_program;
+	ProgramHandle text_program;
+	ProgramHandle volume_program;
+	ProgramHandle voxel_oit_program;
+	ProgramHandle oit_resolve_program;
+	ProgramHandle splat_program;
+
+	// Every instanced draw goes through one of these, see gl_draw_batch.c.
+	GlDrawBatch voxel_batch;
+	GlDrawBatch splat_batch;
+	GlDrawBatch voxel_oit_batch;
+	GlDrawBatch text_batch;
 
 	// Compute programs
-	uint32_t mode_programs[MODES_COUNT];
+	ProgramHandle sort_program;
+	ProgramHandle compact_program;
+	ProgramHandle volume_field_program;
+	ProgramHandle brick_list_program;
+
+	// Mode programs, by mode and grid variant, are built the first time
+	// they're used, and ahead of that in the background, see
+	// gl_update_mode_programs. A handle is only valid once it's
+	// MODE_PROGRAM_READY.
+	bool parallel_shader_compile;
+	ProgramHandle mode_programs[MODES_COUNT][GRID_VARIANTS_COUNT];
+	uint8_t mode_program_states[MODES_COUNT][GRID_VARIANTS_COUNT];
+	PendingProgram pending_mode_programs[MODES_COUNT][GRID_VARIANTS_COUNT];
+
+	// The workgroup size of each mode kernel, in bricks, as tuned for the
+	// renderer, see kernel_tuning.c.
+	KernelTuning kernel_tuning;
+	uint8_t mode_group_sizes[MODES_COUNT][GRID_VARIANTS_COUNT][3];
+
+	// Hot reload, see gl_reload_programs. How each program was built, by
+	// handle, and its rebuild if one is underway.
+	ShaderWatch shader_watch;
+	bool shaders_changed;
+	PendingProgram program_builds[GL_PROGRAMS_MAX];
+	UniformBlockBinding program_uniform_blocks[GL_PROGRAMS_MAX][2];
+	uint32_t program_uniform_blocks_count[GL_PROGRAMS_MAX];
+	bool programs_reloading[GL_PROGRAMS_MAX];
+	PendingProgram program_reloads[GL_PROGRAMS_MAX];
+
+	// The last compile or link error, shown until the next reload.
+	char shader_error[SHADER_ERROR_MAX];
+
+	// The grid length the sort, compaction and brick buffers are currently
+	// sized for, see gl_resize_grid_buffers.
+	uint32_t grid_buffers_length;
+
+	// What the field is currently allocated for, see gl_resize_field.
+	uint32_t field_length;
+	uint8_t field_precision;
+
+	// Which of the two color buffers or field storage textures is the front
+	// field, read by everything this frame. The other is the back field the
+	// mode kernel writes. See gl_dispatch_mode.
+	uint32_t field_front;
+
+	GlOptions options;
+	char shader_defines[SHADER_DEFINES_MAX];
+
+	// Voxel sort tables
+	uint32_t sort_table_stride;
+	uint32_t sort_table_slots;
+	uint32_t sort_table_grid_length;
+	uint32_t sort_permutation;
+
+	// What the mode kernel last ran with, see gl_dispatch_mode.
+	uint8_t dispatched_mode;
+	uint32_t dispatched_grid_length;
+	float dispatched_mode_data[MAX_DIMENSIONS];
+
+	// GL_MAX_COMPUTE_WORK_GROUP_COUNT along x, past which the indirect
+	// dispatch of listed bricks wraps into y, see bricks.comp.
+	uint32_t max_groups_x;
+
+	// Raymarched volume textures
+	uint32_t volume_grid_length;
+
+	// Order independent transparency targets
+	uint32_t oit_width;
+	uint32_t oit_height;
+
+	// Text, mirrored by the text buffer.
+	TextLayout text_layout;
+	Hud hud;
+	uint32_t text_upload_size;
+
+	// Voxel pass timing
+	uint32_t voxel_timer_queries[VOXEL_TIMER_QUERIES_COUNT];
+	float voxel_pass_ms;
+	uint32_t frame_index;
 } GlContext;
 
-uint32_t gl_compile_shader(char* filename, GLenum type)
+void gl_use_program(GlContext* gl, ProgramHandle program)
+{
+	gl_state_use_program(&gl->state, gl_program(&gl->resources, program));
+}
+
+void gl_bind_vertex_array(GlContext* gl, VertexArrayHandle vertex_array)
+{
+	gl_state_bind_vertex_array(&gl->state, gl_vertex_array(&gl->resources, vertex_array));
+}
+
+// Appends the source of filename to src at length, replacing each line of the
+// form #include "name" with the source of shaders/name, and advances length.
+// GLSL has no includes of its own. Returns false, with the reason in error, of
+// SHADER_ERROR_MAX, if a file is missing or it all doesn't fit, which can
+// happen mid-edit with live reload so isn't fatal.
+bool gl_read_shader_source(char* filename, char* src, uint32_t* length, char* error)
 {
-	// Read file
 	FILE* file = fopen(filename, "r");
 	if(file == NULL) 
 	{
-		panic();
+		snprintf(error, SHADER_ERROR_MAX, "couldn't open %s\n", filename);
+		return false;
 	}
-	fseek(file, 0, SEEK_END);
-	uint32_t fsize = ftell(file);
-	fseek(file, 0, SEEK_SET);
-	char src[fsize];
 
-	char c;
-	uint32_t i = 0;
-	while((c = fgetc(file)) != EOF)
+	char line[512];
+	while(fgets(line, sizeof(line), file) != NULL)
 	{
-		src[i] = c;
-		i++;
+		char include_name[256];
+		if(sscanf(line, "#include \"%255[^\"]\"", include_name) == 1)
+		{
+			char include_filename[512];
+			sprintf(include_filename, "shaders/%s", include_name);
+			if(!gl_read_shader_source(include_filename, src, length, error))
+			{
+				fclose(file);
+				return false;
+			}
+			continue;
+		}
+
+		uint32_t line_length = strlen(line);
+		if(*length + line_length >= SHADER_SOURCE_MAX)
+		{
+			snprintf(error, SHADER_ERROR_MAX, "%s: source too long\n", filename);
+			fclose(file);
+			return false;
+		}
+		memcpy(&src[*length], line, line_length);
+		*length += line_length;
 	}
-	src[i] = '\0';
+	src[*length] = '\0';
 	fclose(file);
 
-	// Compile shader
+	return true;
+}
+
+// Fills source with the full text of the shader as it's compiled, with
+// defines in right after the #version line, which has to come first. Returns
+// false with the reason in error, as gl_read_shader_source.
+bool gl_load_shader_source(char* filename, char* defines, char* source, char* error)
+{
+	static char src[SHADER_SOURCE_MAX];
+	uint32_t length = 0;
+	if(!gl_read_shader_source(filename, src, &length, error))
+	{
+		return false;
+	}
+
+	char* body = strchr(src, '\n');
+	if(body == NULL)
+	{
+		snprintf(error, SHADER_ERROR_MAX, "%s: no #version line\n", filename);
+		return false;
+	}
+	body++;
+
+	uint32_t version_length = body - src;
+	memcpy(source, src, version_length);
+	strcpy(&source[version_length], defines);
+	strcat(source, body);
+	return true;
+}
+
+// Compile errors are only looked for by gl_link_program, as asking waits on
+// the compiler.
+uint32_t gl_compile_shader(char* source, GLenum type)
+{
 	uint32_t shader = glCreateShader(type);
-	const char* src_ptr = src;
-	glShaderSource(shader, 1, &src_ptr, 0);
+	const char* src_ptrs[] = { source };
+	glShaderSource(shader, 1, src_ptrs, NULL);
 	glCompileShader(shader);
 
-	int32_t success;
-	char info[512];
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-	if(success == false)
+	return shader;
+}
+
+// The full text of each stage of the program last loaded.
+static char gl_loaded_sources[2][SHADER_SOURCE_MAX + SHADER_DEFINES_MAX + SHADER_VARIANT_DEFINES_MAX];
+
+// Loads the source of each stage and works out the program's cache key, to
+// be built by gl_build_program. variant_defines go in after the context's
+// shader defines, for programs built more than one way. Returns false with
+// the reason in error, of SHADER_ERROR_MAX, if the source couldn't be loaded.
+bool gl_load_program(GlContext* gl, char** filenames, GLenum* types, uint32_t stages_count, char* variant_defines, PendingProgram* pending, char* error)
+{
+	char* source_ptrs[2];
+	if(stages_count > 2 || strlen(variant_defines) >= SHADER_VARIANT_DEFINES_MAX)
 	{
-		glGetShaderInfoLog(shader, 512, NULL, info);
-		printf(info);
 		panic();
 	}
 
-	printf("compiled %s\n", filename);
+	strcpy(pending->variant_defines, variant_defines);
+	char defines[SHADER_DEFINES_MAX + SHADER_VARIANT_DEFINES_MAX];
+	sprintf(defines, "%s%s", gl->shader_defines, variant_defines);
 
-	return shader;
+	for(uint32_t i = 0; i < stages_count; i++)
+	{
+		if(!gl_load_shader_source(filenames[i], defines, gl_loaded_sources[i], error))
+		{
+			return false;
+		}
+		source_ptrs[i] = gl_loaded_sources[i];
+		pending->filenames[i] = filenames[i];
+		pending->types[i] = types[i];
+	}
+	pending->stages_count = stages_count;
+	pending->key = program_cache_key(&gl->program_cache, source_ptrs, stages_count);
+	return true;
+}
+
+// Loads the program last loaded by gl_load_program from the program cache, or
+// else starts compiling and linking it. With GL_ARB_parallel_shader_compile
+// the compiling and linking happen on the driver's threads, and nothing waits
+// on them until gl_link_program.
+void gl_build_program(GlContext* gl, PendingProgram* pending)
+{
+	pending->program = program_cache_load(&gl->program_cache, pending->key);
+	pending->cached = pending->program != 0;
+	if(pending->cached)
+	{
+		return;
+	}
+
+	pending->program = glCreateProgram();
+	for(uint32_t i = 0; i < pending->stages_count; i++)
+	{
+		pending->shaders[i] = gl_compile_shader(gl_loaded_sources[i], pending->types[i]);
+		glAttachShader(pending->program, pending->shaders[i]);
+	}
+
+	glProgramParameteri(pending->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(pending->program);
+}
+
+bool gl_begin_program(GlContext* gl, char** filenames, GLenum* types, uint32_t stages_count, char* variant_defines, PendingProgram* pending, char* error)
+{
+	if(!gl_load_program(gl, filenames, types, stages_count, variant_defines, pending, error))
+	{
+		return false;
+	}
+	gl_build_program(gl, pending);
+	return true;
+}
+
+// Whether gl_link_program can be called without waiting. Without
+// GL_ARB_parallel_shader_compile there's no asking, so always.
+bool gl_program_done(GlContext* gl, PendingProgram* pending)
+{
+	if(pending->cached || !gl->parallel_shader_compile)
+	{
+		return true;
+	}
+
+	int32_t done;
+	glGetProgramiv(pending->program, GL_COMPLETION_STATUS_ARB, &done);
+	return done;
+}
+
+// Waits for the program to be built, if it isn't already, and caches it. On a
+// compile or link error, the program is deleted and false returned, with the
+// log in error, of SHADER_ERROR_MAX.
+bool gl_link_program(GlContext* gl, PendingProgram* pending, char* error)
+{
+	if(pending->cached)
+	{
+		return true;
+	}
+
+	// Leaving room for the filename in front of it.
+	char info[SHADER_ERROR_MAX - 64];
+	bool success = true;
+	for(uint32_t i = 0; i < pending->stages_count && success; i++)
+	{
+		int32_t compiled;
+		glGetShaderiv(pending->shaders[i], GL_COMPILE_STATUS, &compiled);
+		if(compiled == false)
+		{
+			glGetShaderInfoLog(pending->shaders[i], sizeof(info), NULL, info);
+			snprintf(error, SHADER_ERROR_MAX, "%s: %s", pending->filenames[i], info);
+			success = false;
+		}
+	}
+
+	int32_t linked;
+	glGetProgramiv(pending->program, GL_LINK_STATUS, &linked);
+	if(success && linked == false)
+	{
+		glGetProgramInfoLog(pending->program, sizeof(info), NULL, info);
+		snprintf(error, SHADER_ERROR_MAX, "%s: %s", pending->filenames[0], info);
+		success = false;
+	}
+
+	for(uint32_t i = 0; i < pending->stages_count; i++)
+	{
+		glDeleteShader(pending->shaders[i]);
+	}
+
+	if(!success)
+	{
+		glDeleteProgram(pending->program);
+		return false;
+	}
+
+	for(uint32_t i = 0; i < pending->stages_count; i++)
+	{
+		printf("compiled %s\n", pending->filenames[i]);
+	}
+
+	program_cache_store(&gl->program_cache, pending->key, pending->program);
+	return true;
+}
+
+// Hands a linked program to gl_resources.c, remembering how it was built.
+ProgramHandle gl_add_built_program(GlContext* gl, PendingProgram* pending)
+{
+	ProgramHandle handle = gl_add_program(&gl->resources, pending->program);
+	gl->program_builds[handle.index] = *pending;
+	gl->program_uniform_blocks_count[handle.index] = 0;
+	gl->programs_reloading[handle.index] = false;
+
+	return handle;
+}
+
+// For programs the renderer can't go without, so errors are fatal.
+ProgramHandle gl_create_program(GlContext* gl, char** filenames, GLenum* types, uint32_t stages_count)
+{
+	PendingProgram pending;
+	char error[SHADER_ERROR_MAX];
+	if(!gl_begin_program(gl, filenames, types, stages_count, "", &pending, error)
+		|| !gl_link_program(gl, &pending, error))
+	{
+		printf("%s", error);
+		panic();
+	}
+	return gl_add_built_program(gl, &pending);
+}
+
+ProgramHandle gl_create_raster_program(GlContext* gl, char* vert_filename, char* frag_filename)
+{
+	char* filenames[] = { vert_filename, frag_filename };
+	GLenum types[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+	return gl_create_program(gl, filenames, types, 2);
+}
+
+// Resolves the block's index once, after linking, rather than every frame.
+// Blocks the compiler dropped for being unused have no index, which is fine.
+void gl_apply_uniform_block(uint32_t program, char* block_name, uint32_t slot)
+{
+	uint32_t block_index = glGetUniformBlockIndex(program, block_name);
+	if(block_index != GL_INVALID_INDEX)
+	{
+		glUniformBlockBinding(program, block_index, slot);
+	}
+}
+
+// Kept with the program, so it's applied again when the program is reloaded.
+void gl_bind_uniform_block(GlContext* gl, ProgramHandle handle, char* block_name, uint32_t slot)
+{
+	uint32_t* count = &gl->program_uniform_blocks_count[handle.index];
+	if(*count >= 2)
+	{
+		panic();
+	}
+
+	gl->program_uniform_blocks[handle.index][*count] = (UniformBlockBinding){ .name = block_name, .slot = slot };
+	(*count)++;
+	gl_apply_uniform_block(gl_program(&gl->resources, handle), block_name, slot);
+}
+
+ProgramHandle gl_create_compute_program(GlContext* gl, char* filename)
+{
+	GLenum type = GL_COMPUTE_SHADER;
+	return gl_create_program(gl, &filename, &type, 1);
+}
+
+bool gl_has_extension(char* name)
+{
+	int32_t extensions_count;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensions_count);
+	for(int32_t i = 0; i < extensions_count; i++)
+	{
+		if(strcmp((char*)glGetStringi(GL_EXTENSIONS, i), name) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+uint32_t gl_grid_variant(uint32_t grid_length)
+{
+	return __builtin_ctz(grid_length) - __builtin_ctz(GRID_MIN_LENGTH);
+}
+
+// GRID_LENGTH is defined for the kernel so the compiler can fold the index
+// math on it, and LOCAL_SIZE_X/Y/Z for its workgroup of group_size bricks.
+void gl_mode_program_defines(uint32_t grid_length, uint8_t* group_size, char* defines)
+{
+	sprintf(defines, "#define GRID_LENGTH %u\n#define LOCAL_SIZE_X %u\n#define LOCAL_SIZE_Y %u\n#define LOCAL_SIZE_Z %u\n", grid_length, group_size[0] * 4, group_size[1] * 4, group_size[2] * 4);
+}
+
+// The workgroups a dispatch over the whole grid takes, rounding up, so the
+// last can run past the grid.
+void gl_mode_groups(uint32_t grid_length, uint8_t* group_size, uint32_t* groups)
+{
+	uint32_t brick_length = grid_length / 4;
+	for(uint32_t i = 0; i < 3; i++)
+	{
+		groups[i] = (brick_length + group_size[i] - 1) / group_size[i];
+	}
+}
+
+// Starts building the mode's kernel for grid_length, if it hasn't been
+// already, and returns whether it was started.
+bool gl_request_mode_program(GlContext* gl, Game* game, uint8_t mode, uint32_t grid_length)
+{
+	uint32_t variant = gl_grid_variant(grid_length);
+	if(gl->mode_program_states[mode][variant] != MODE_PROGRAM_UNREQUESTED)
+	{
+		return false;
+	}
+
+	char* filename = game->modes[mode].compute_filename;
+	GLenum type = GL_COMPUTE_SHADER;
+	char defines[SHADER_VARIANT_DEFINES_MAX];
+	gl_mode_program_defines(grid_length, gl->mode_group_sizes[mode][variant], defines);
+	if(!gl_begin_program(gl, &filename, &type, 1, defines, &gl->pending_mode_programs[mode][variant], gl->shader_error))
+	{
+		printf("%s", gl->shader_error);
+		gl->mode_program_states[mode][variant] = MODE_PROGRAM_FAILED;
+		return true;
+	}
+	gl->mode_program_states[mode][variant] = MODE_PROGRAM_BUILDING;
+
+	return true;
+}
+
+// A kernel that doesn't build is left MODE_PROGRAM_FAILED, showing the error,
+// until the shaders change again.
+void gl_finish_mode_program(GlContext* gl, uint8_t mode, uint32_t variant)
+{
+	PendingProgram* pending = &gl->pending_mode_programs[mode][variant];
+	if(!gl_link_program(gl, pending, gl->shader_error))
+	{
+		printf("%s", gl->shader_error);
+		gl->mode_program_states[mode][variant] = MODE_PROGRAM_FAILED;
+		return;
+	}
+
+	ProgramHandle program = gl_add_built_program(gl, pending);
+	gl_bind_uniform_block(gl, program, "in_ubo", UBO_SLOT_MODE);
+	gl_bind_uniform_block(gl, program, "in_voxel_ubo", UBO_SLOT_VOXEL);
+	gl->mode_programs[mode][variant] = program;
+	gl->mode_program_states[mode][variant] = MODE_PROGRAM_READY;
+}
+
+// Called at the start of every frame. Requests the current mode's program for
+// its grid length if it hasn't been, finishes every program that's done
+// building, and requests one more ahead of its use. That's each other mode at
+// its grid length, nearest the current mode first since that's where Tab
+// goes, then the current mode at the grid lengths either side. Until the
+// current mode's program is ready, gl_loop draws the field as it was.
+//
+// Without GL_ARB_parallel_shader_compile every build is done as far as
+// gl_program_done knows, and finishing it waits on the compiler, so every
+// build stalls the main thread. Building ahead is then held to one program
+// every MODE_PROGRAM_PREFETCH_FRAMES, so the stalls are spread out rather
+// than costing every frame until all are built. The current mode's own
+// program isn't held back, as it's needed now.
+void gl_update_mode_programs(GlContext* gl, Game* game)
+{
+	uint32_t grid_length = game->modes[game->current_mode].grid_length;
+	gl_request_mode_program(gl, game, game->current_mode, grid_length);
+
+	for(uint32_t i = 0; i < MODES_TMP_COUNT; i++) // TODO - should just be 256 once all levels exist.
+	{
+		for(uint32_t j = 0; j < GRID_VARIANTS_COUNT; j++)
+		{
+			if(gl->mode_program_states[i][j] == MODE_PROGRAM_BUILDING && gl_program_done(gl, &gl->pending_mode_programs[i][j]))
+			{
+				gl_finish_mode_program(gl, i, j);
+			}
+		}
+	}
+
+	if(!gl->parallel_shader_compile && gl->frame_index % MODE_PROGRAM_PREFETCH_FRAMES != 0)
+	{
+		return;
+	}
+
+	for(uint32_t distance = 1; distance < MODES_TMP_COUNT; distance++)
+	{
+		uint8_t next = (game->current_mode + distance) % MODES_TMP_COUNT;
+		uint8_t previous = (game->current_mode + MODES_TMP_COUNT - distance) % MODES_TMP_COUNT;
+		if(gl_request_mode_program(gl, game, next, game->modes[next].grid_length)
+			|| gl_request_mode_program(gl, game, previous, game->modes[previous].grid_length))
+		{
+			return;
+		}
+	}
+
+	if(grid_length < GRID_MAX_LENGTH && gl_request_mode_program(gl, game, game->current_mode, grid_length * 2))
+	{
+		return;
+	}
+	if(grid_length > GRID_MIN_LENGTH)
+	{
+		gl_request_mode_program(gl, game, game->current_mode, grid_length / 2);
+	}
 }
 
+// Called at the start of every frame. Once the shader directory changes, every
+// program whose full source now differs, includes and all, is rebuilt in the
+// background as mode programs are. Each takes the place of the old program
+// behind its handle only once it links, so a shader with errors leaves the old
+// one running and the error on the HUD. Modes that failed get another go.
+//
+// Changes made while a rebuild is underway are picked up once it's done.
+void gl_reload_programs(GlContext* gl)
+{
+	if(shader_watch_poll(&gl->shader_watch))
+	{
+		gl->shaders_changed = true;
+	}
+
+	bool reloading = false;
+	for(uint32_t i = 0; i < gl->resources.programs_count; i++)
+	{
+		if(!gl->programs_reloading[i])
+		{
+			continue;
+		}
+
+		PendingProgram* pending = &gl->program_reloads[i];
+		if(!gl_program_done(gl, pending))
+		{
+			reloading = true;
+			continue;
+		}
+
+		gl->programs_reloading[i] = false;
+		if(!gl_link_program(gl, pending, gl->shader_error))
+		{
+			printf("%s", gl->shader_error);
+			continue;
+		}
+
+		ProgramHandle handle = { .index = i };
+		gl_replace_program(&gl->resources, &gl->state, handle, pending->program);
+		gl->program_builds[i] = *pending;
+		for(uint32_t j = 0; j < gl->program_uniform_blocks_count[i]; j++)
+		{
+			UniformBlockBinding* block = &gl->program_uniform_blocks[i][j];
+			gl_apply_uniform_block(pending->program, block->name, block->slot);
+		}
+	}
+
+	if(reloading || !gl->shaders_changed)
+	{
+		return;
+	}
+	gl->shaders_changed = false;
+	gl->shader_error[0] = '\0';
+
+	for(uint32_t i = 0; i < gl->resources.programs_count; i++)
+	{
+		PendingProgram* build = &gl->program_builds[i];
+		PendingProgram* pending = &gl->program_reloads[i];
+		if(!gl_load_program(gl, build->filenames, build->types, build->stages_count, build->variant_defines, pending, gl->shader_error))
+		{
+			printf("%s", gl->shader_error);
+			continue;
+		}
+		if(pending->key != build->key)
+		{
+			gl_build_program(gl, pending);
+			gl->programs_reloading[i] = true;
+		}
+	}
 
-void gl_init(GlContext* gl, Game* game)
+	for(uint32_t i = 0; i < MODES_TMP_COUNT; i++)
+	{
+		for(uint32_t j = 0; j < GRID_VARIANTS_COUNT; j++)
+		{
+			if(gl->mode_program_states[i][j] == MODE_PROGRAM_FAILED)
+			{
+				gl->mode_program_states[i][j] = MODE_PROGRAM_UNREQUESTED;
+			}
+		}
+	}
+}
+
+void gl_init(GlContext* gl, Game* game, GlOptions* options)
 {
 	if(gl3wInit() != 0) 
 	{
@@ -140,100 +924,99 @@ void gl_init(GlContext* gl, Game* game)
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glEnable(GL_PROGRAM_POINT_SIZE);
+
+	gl_state_init(&gl->state, true);
+	gl_resources_init(&gl->resources);
+	gl_barriers_init(&gl->barriers);
+	program_cache_init(&gl->program_cache);
+	GlResources* resources = &gl->resources;
+
+	// Parallel shader compilation
+	// Has the driver compile and link on threads of its own, so that building
+	// a program only waits once the program is used.
+	gl->parallel_shader_compile = gl_has_extension("GL_ARB_parallel_shader_compile");
+	if(gl->parallel_shader_compile)
+	{
+		PFNGLMAXSHADERCOMPILERTHREADSARBPROC max_shader_compiler_threads = (PFNGLMAXSHADERCOMPILERTHREADSARBPROC)gl3wGetProcAddress("glMaxShaderCompilerThreadsARB");
+		max_shader_compiler_threads(0xFFFFFFFF);
+	}
 
-	// Voxel program
-	// TODO - factor out program creation
-	uint32_t voxel_vert_shader = gl_compile_shader("shaders/voxel.vert", GL_VERTEX_SHADER);
-	uint32_t voxel_frag_shader = gl_compile_shader("shaders/voxel.frag", GL_FRAGMENT_SHADER);
-
-	gl->voxel_program = glCreateProgram();
-	glAttachShader(gl->voxel_program, voxel_vert_shader);
-	glAttachShader(gl->voxel_program, voxel_frag_shader);
-	glLinkProgram(gl->voxel_program);
+	// Hot reload
+	// The build copies src/shaders over, so it's the copy that's watched.
+	shader_watch_init(&gl->shader_watch, "shaders");
+	gl->shaders_changed = false;
+	gl->shader_error[0] = '\0';
 
-	glDeleteShader(voxel_vert_shader);
-	glDeleteShader(voxel_frag_shader);
+	// Shader defines
+	gl->options = *options;
+	gl->shader_defines[0] = '\0';
+	if(options->field_storage == FIELD_STORAGE_IMAGE)
+	{
+		strcat(gl->shader_defines, "#define FIELD_STORAGE_IMAGE\n");
+	}
+	if(options->field_layout == FIELD_LAYOUT_MORTON)
+	{
+		strcat(gl->shader_defines, "#define FIELD_LAYOUT_MORTON\n");
+	}
 
-	uint32_t text_vert_shader = gl_compile_shader("shaders/text.vert", GL_VERTEX_SHADER);
-	uint32_t text_frag_shader = gl_compile_shader("shaders/text.frag", GL_FRAGMENT_SHADER);
+	// Raster programs
+	gl->voxel_program = gl_create_raster_program(gl, "shaders/voxel.vert", "shaders/voxel.frag");
+	gl->text_program = gl_create_raster_program(gl, "shaders/text.vert", "shaders/text.frag");
+	gl->volume_program = gl_create_raster_program(gl, "shaders/volume.vert", "shaders/volume.frag");
+	gl->voxel_oit_program = gl_create_raster_program(gl, "shaders/voxel_oit.vert", "shaders/voxel_oit.frag");
+	gl->oit_resolve_program = gl_create_raster_program(gl, "shaders/volume.vert", "shaders/oit_resolve.frag");
+	gl->splat_program = gl_create_raster_program(gl, "shaders/splat.vert", "shaders/voxel.frag");
+
+	// Mode programs
+	// Only the current mode's is needed for the first frame. The rest are built
+	// as gl_loop goes, at the workgroup sizes they were tuned to.
+	kernel_tuning_load(&gl->kernel_tuning);
+	for(uint32_t i = 0; i < MODES_COUNT; i++)
+	{
+		for(uint32_t j = 0; j < GRID_VARIANTS_COUNT; j++)
+		{
+			uint8_t* group_size = gl->mode_group_sizes[i][j];
+			if(!kernel_tuning_find(&gl->kernel_tuning, game->modes[i].compute_filename, GRID_MIN_LENGTH << j, group_size))
+			{
+				memcpy(group_size, mode_group_sizes[0], 3);
+			}
+		}
+	}
 
-	gl->text_program = glCreateProgram();
-	glAttachShader(gl->text_program, text_vert_shader);
-	glAttachShader(gl->text_program, text_frag_shader);
-	glLinkProgram(gl->text_program);
+	memset(gl->mode_program_states, MODE_PROGRAM_UNREQUESTED, sizeof(gl->mode_program_states));
+	uint32_t grid_length = game->modes[game->current_mode].grid_length;
+	gl_request_mode_program(gl, game, game->current_mode, grid_length);
+	gl_finish_mode_program(gl, game->current_mode, gl_grid_variant(grid_length));
 
-	glDeleteShader(text_vert_shader);
-	glDeleteShader(text_frag_shader);
+	// Voxel sort program
+	gl->sort_program = gl_create_compute_program(gl, "shaders/sort.comp");
 
-	// Mode program
-	for(uint8_t i = 0; i < MODES_TMP_COUNT; i++) // TODO - should just be 256 once all levels exist.
-	{
-		Mode* mode = &game->modes[i];
+	// Visible voxel compaction program
+	gl->compact_program = gl_create_compute_program(gl, "shaders/compact.comp");
 
-		uint32_t mode_shader = gl_compile_shader(mode->compute_filename, GL_COMPUTE_SHADER);
-		gl->mode_programs[i] = glCreateProgram();
-		glAttachShader(gl->mode_programs[i], mode_shader);
-		glLinkProgram(gl->mode_programs[i]);
-		glDeleteShader(mode_shader);
-	}
+	// Volume field program
+	gl->volume_field_program = gl_create_compute_program(gl, "shaders/volume.comp");
 
-	// Vertex arrays/buffers
-	float voxel_vertices[] =
-	{
-		-1.0f, -1.0f, -1.0f,
-		 1.0f, -1.0f, -1.0f,
-		 1.0f,  1.0f, -1.0f,
-		 1.0f,  1.0f, -1.0f,
-		-1.0f,  1.0f, -1.0f,
-		-1.0f, -1.0f, -1.0f,
-
-		-1.0f, -1.0f,  1.0f,
-		 1.0f, -1.0f,  1.0f,
-		 1.0f,  1.0f,  1.0f,
-		 1.0f,  1.0f,  1.0f,
-		-1.0f,  1.0f,  1.0f,
-		-1.0f, -1.0f,  1.0f,
-
-		-1.0f,  1.0f,  1.0f,
-		-1.0f,  1.0f, -1.0f,
-		-1.0f, -1.0f, -1.0f,
-		-1.0f, -1.0f, -1.0f,
-		-1.0f, -1.0f,  1.0f,
-		-1.0f,  1.0f,  1.0f,
-
-		 1.0f,  1.0f,  1.0f,
-		 1.0f,  1.0f, -1.0f,
-		 1.0f, -1.0f, -1.0f,
-		 1.0f, -1.0f, -1.0f,
-		 1.0f, -1.0f,  1.0f,
-		 1.0f,  1.0f,  1.0f,
-
-		-1.0f, -1.0f, -1.0f,
-		 1.0f, -1.0f, -1.0f,
-		 1.0f, -1.0f,  1.0f,
-		 1.0f, -1.0f,  1.0f,
-		-1.0f, -1.0f,  1.0f,
-		-1.0f, -1.0f, -1.0f,
-
-		-1.0f,  1.0f, -1.0f,
-		 1.0f,  1.0f, -1.0f,
-		 1.0f,  1.0f,  1.0f,
-		 1.0f,  1.0f,  1.0f,
-		-1.0f,  1.0f,  1.0f,
-		-1.0f,  1.0f, -1.0f,	
-	};
+	// Brick dispatch list program
+	gl->brick_list_program = gl_create_compute_program(gl, "shaders/bricks.comp");
 
-	// TODO - factor out vbo/vao creation
-	glGenVertexArrays(1, &gl->voxel_vao);
-	glBindVertexArray(gl->voxel_vao);
+	printf("programs: %u from cache, %u compiled\n", gl->program_cache.programs_loaded, gl->program_cache.programs_compiled);
 
-	uint32_t voxel_vertex_buffer;
-	glGenBuffers(1, &voxel_vertex_buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, voxel_vertex_buffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(voxel_vertices), voxel_vertices, GL_STATIC_DRAW);
+	// Uniform blocks
+	gl_bind_uniform_block(gl, gl->voxel_program, "in_ubo", UBO_SLOT_VOXEL);
+	gl_bind_uniform_block(gl, gl->volume_program, "in_ubo", UBO_SLOT_VOXEL);
+	gl_bind_uniform_block(gl, gl->voxel_oit_program, "in_ubo", UBO_SLOT_VOXEL);
+	gl_bind_uniform_block(gl, gl->splat_program, "in_ubo", UBO_SLOT_VOXEL);
+	gl_bind_uniform_block(gl, gl->sort_program, "in_ubo", UBO_SLOT_VOXEL);
+	gl_bind_uniform_block(gl, gl->compact_program, "in_ubo", UBO_SLOT_VOXEL);
+	gl_bind_uniform_block(gl, gl->volume_field_program, "in_ubo", UBO_SLOT_VOXEL);
+	gl_bind_uniform_block(gl, gl->brick_list_program, "in_ubo", UBO_SLOT_VOXEL);
 
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+	// Vertex arrays/buffers
+	// Cubes are generated from the vertex id in voxel.vert, so there is no
+	// vertex buffer to go with this.
+	gl->voxel_vao = gl_create_vertex_array(resources);
 
 	float text_quad_vertices[] =
 	{
@@ -246,20 +1029,22 @@ void gl_init(GlContext* gl, Game* game)
 		-1.0f,  1.0f
 	};
 
-	glGenVertexArrays(1, &gl->text_vao);
-	glBindVertexArray(gl->text_vao);
+	BufferHandle text_vertex_buffer = gl_create_buffer(resources, sizeof(text_quad_vertices), text_quad_vertices, 0);
+	gl->text_vao = gl_create_vertex_array(resources);
+	gl_vertex_array_float_attribute(resources, gl->text_vao, 0, 2, 0, text_vertex_buffer, 2 * sizeof(float));
 
-	uint32_t text_vertex_buffer;
-	glGenBuffers(1, &text_vertex_buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, text_vertex_buffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(text_quad_vertices), text_quad_vertices, GL_STATIC_DRAW);
+	// The full screen triangle is generated from the vertex id.
+	gl->volume_vao = gl_create_vertex_array(resources);
 
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+	// Draw batches
+	gl_draw_batch_init(&gl->voxel_batch, gl->voxel_program, gl->voxel_vao, GL_TRIANGLES, sizeof(VoxelDraw));
+	gl_draw_batch_init(&gl->splat_batch, gl->splat_program, gl->voxel_vao, GL_POINTS, sizeof(VoxelDraw));
+	gl_draw_batch_init(&gl->voxel_oit_batch, gl->voxel_oit_program, gl->voxel_vao, GL_TRIANGLES, sizeof(VoxelDraw));
+	gl_draw_batch_init(&gl->text_batch, gl->text_program, gl->text_vao, GL_TRIANGLES, sizeof(TextDraw));
 
 	// Font atlas texture
 	glGenTextures(1, &gl->font_texture);
-	glBindTexture(GL_TEXTURE_2D, gl->font_texture);
+	gl_state_bind_texture(&gl->state, 0, GL_TEXTURE_2D, gl->font_texture);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
@@ -275,80 +1060,780 @@ void gl_init(GlContext* gl, Game* game)
 	glGenerateMipmap(GL_TEXTURE_2D);
 	stbi_image_free(tex_data);
 
+	// Field storage textures
+	// Only with FIELD_STORAGE_IMAGE, created for the grid size on first use.
+	// See gl_resize_field.
+	gl->field_storage_textures[0] = 0;
+	gl->field_storage_textures[1] = 0;
+
+	// Raymarched volume textures
+	// Storage is (re)allocated for the grid size on first use, see
+	// gl_draw_voxels_raymarched.
+	glGenTextures(1, &gl->field_texture);
+	glGenTextures(1, &gl->brick_texture);
+	gl->volume_grid_length = 0;
+
+	// Order independent transparency targets
+	// Sized to the window on first use, see gl_draw_voxels_oit.
+	glGenTextures(1, &gl->oit_accumulation_texture);
+	glGenTextures(1, &gl->oit_revealage_texture);
+	glGenFramebuffers(1, &gl->oit_framebuffer);
+	gl->oit_width = 0;
+	gl->oit_height = 0;
+
 	// SSBOs
-	// TODO - factor out ssbo creation
-	float colors[GRID_MAX_VOLUME];
-
-	uint32_t color_ssbo;
-	glGenBuffers(1, &color_ssbo);
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, color_ssbo);
-	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(colors), NULL, GL_DYNAMIC_DRAW);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, color_ssbo);
-
-	glGenBuffers(1, &gl->text_buffer);
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl->text_buffer);
-	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(TextChar[TEXT_MAX_CHARS]), NULL, GL_DYNAMIC_DRAW);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, gl->text_buffer);
-
-	glGenBuffers(1, &gl->instance_to_voxel_buffer);
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl->instance_to_voxel_buffer);
-	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(int32_t[GRID_MAX_VOLUME]), NULL, GL_DYNAMIC_DRAW);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, gl->instance_to_voxel_buffer);
-
-	// UBOs
-	// TODO - factor out ubo creation
-	glGenBuffers(1, &gl->voxel_ubo_buffer);
-	glBindBuffer(GL_UNIFORM_BUFFER, gl->voxel_ubo_buffer);
-	glBufferData(GL_UNIFORM_BUFFER, sizeof(VoxelUbo), NULL, GL_DYNAMIC_DRAW);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
-
-	glGenBuffers(1, &gl->text_ubo_buffer);
-	glBindBuffer(GL_UNIFORM_BUFFER, gl->text_ubo_buffer);
-	glBufferData(GL_UNIFORM_BUFFER, sizeof(TextUbo), NULL, GL_DYNAMIC_DRAW);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
-
-	glGenBuffers(1, &gl->mode_data_ubo_buffer);
-	glBindBuffer(GL_UNIFORM_BUFFER, gl->mode_data_ubo_buffer);
-	glBufferData(GL_UNIFORM_BUFFER, sizeof(ModeUbo), NULL, GL_DYNAMIC_DRAW);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	// Everything sized by the grid is given its real size on first use, see
+	// gl_resize_field and gl_resize_grid_buffers.
+	gl->color_buffers[0] = gl_create_buffer(resources, sizeof(uint32_t), NULL, 0);
+	gl->color_buffers[1] = gl_create_buffer(resources, sizeof(uint32_t), NULL, 0);
+	gl->instance_to_voxel_buffer = gl_create_buffer(resources, sizeof(int32_t), NULL, 0);
+	gl->visible_voxel_buffer = gl_create_buffer(resources, sizeof(int32_t), NULL, 0);
+	gl->compact_block_buffer = gl_create_buffer(resources, sizeof(uint32_t), NULL, 0);
+	gl->brick_buffer = gl_create_buffer(resources, sizeof(uint32_t), NULL, 0);
+	gl->brick_dispatch_buffer = gl_create_buffer(resources, sizeof(BrickDispatch), NULL, 0);
+	int32_t max_groups_x;
+	glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &max_groups_x);
+	gl->max_groups_x = max_groups_x;
+	gl->grid_buffers_length = 0;
+	gl->field_length = 0;
+	gl->field_front = 0;
+
+	// Only the characters that changed are uploaded, see gl_upload_text.
+	gl->text_buffer = gl_create_buffer(resources, sizeof(TextChar[TEXT_MAX_CHARS]), NULL, GL_DYNAMIC_STORAGE_BIT);
+	gl->text_upload_size = 0;
+
+	// HUD text
+	// Static strings are set once here, the rest as they change in gl_loop.
+	TextLayout* text_layout = &gl->text_layout;
+	Hud* hud = &gl->hud;
+	text_layout_init(text_layout);
+
+	text_object_init(text_layout, &hud->title, 48, 2.35f, 28.25f, 1.0f, 1.0f);
+	text_object_init(text_layout, &hud->description, 96, 4, 59, 0.5f, 1.0f);
+	text_object_init(text_layout, &hud->space_prompt, 8, 49.8f, 36.0f, 0.66f, 1.0f);
+	for(uint8_t i = 0; i < MAX_DIMENSIONS; i++)
+	{
+		text_object_init(text_layout, &hud->dimensions[i], 16, 4, 2.5 + i * 1.5, 0.66f, 1.0f);
+		hud->dimension_values[i] = 0.0f;
+	}
+	text_object_init(text_layout, &hud->renderer, 40, 6, 0, 0.5f, 1.0f);
+	text_object_init(text_layout, &hud->precision, 16, 6, 0, 0.5f, 1.0f);
+	text_object_init(text_layout, &hud->grid, 56, 6, 0, 0.5f, 1.0f);
+	text_object_init(text_layout, &hud->gl_stats, 64, 6, 0, 0.5f, 1.0f);
+	text_object_init(text_layout, &hud->shader_error, 96, 6, 0, 0.5f, 1.0f);
+
+	text_object_set_string(text_layout, &hud->description, "This is just a small showcase of what our world, nay, our universe, is capable of.");
+	text_object_set_string(text_layout, &hud->space_prompt, "[Space]");
+
+	gl->sort_table_grid_length = 0;
+	gl->sort_permutation = SORT_PERMUTATIONS_COUNT;
+
+	// Nothing has been dispatched yet, so the first frame runs every brick.
+	gl->dispatched_mode = 0;
+	gl->dispatched_grid_length = 0;
+
+	// Indirect draw buffers
+	// Whatever isn't fixed here, the visible voxel count, is filled in on the
+	// GPU by the compaction pass each frame.
+	VoxelDraws voxel_draws =
+	{
+		.cubes = { .count = VOXEL_VERTICES_COUNT, .instance_count = 0, .first = 0, .base_instance = 0 },
+		.splats = { .count = 0, .instance_count = 1, .first = 0, .base_instance = 0 }
+	};
+
+	gl->voxel_draw_buffer = gl_create_buffer(resources, sizeof(voxel_draws), &voxel_draws, 0);
+	gl_state_bind_buffer_base(&gl->state, GL_SHADER_STORAGE_BUFFER, 5, gl_buffer(resources, gl->voxel_draw_buffer));
+
+	// Per frame uploads
+	// The voxel and mode UBOs, then the commands and parameters of one voxel
+	// batch and the text batch.
+	uint32_t upload_size = sizeof(VoxelUbo) + sizeof(ModeUbo) + gl_draw_batch_upload_size(sizeof(VoxelDraw)) + gl_draw_batch_upload_size(sizeof(TextDraw));
+	upload_ring_init(&gl->upload_ring, upload_size, 6);
+
+	// Queries
+	glCreateQueries(GL_TIME_ELAPSED, VOXEL_TIMER_QUERIES_COUNT, gl->voxel_timer_queries);
+	gl->voxel_pass_ms = 0.0f;
+	gl->frame_index = 0;
+}
+
+// (Re)allocates both of the mode's color fields for grid_length at
+// field_precision, one of FIELD_PRECISION_*. Fields stored in an image are
+// always fp16. Both start out cleared, so the first frame after draws nothing,
+// and every brick is dispatched that frame.
+void gl_resize_field(GlContext* gl, uint32_t grid_length, uint8_t field_precision)
+{
+	GlResources* resources = &gl->resources;
+	GlState* state = &gl->state;
+
+	uint32_t grid_volume = grid_length * grid_length * grid_length;
+
+	// The fields live in either the color buffers or the field storage
+	// textures. The others are left empty.
+	for(uint32_t i = 0; i < 2; i++)
+	{
+		if(gl->options.field_storage == FIELD_STORAGE_IMAGE)
+		{
+			uint32_t* texture = &gl->field_storage_textures[i];
+			if(*texture != 0)
+			{
+				gl_state_forget_texture(state, *texture);
+				glDeleteTextures(1, texture);
+			}
+
+			// Linear filtering is there for anything that wants it. texelFetch
+			// ignores it.
+			glCreateTextures(GL_TEXTURE_3D, 1, texture);
+			glTextureStorage3D(*texture, 1, GL_R16F, grid_length, grid_length, grid_length);
+			glTextureParameteri(*texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTextureParameteri(*texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTextureParameteri(*texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTextureParameteri(*texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTextureParameteri(*texture, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+			glClearTexImage(*texture, 0, GL_RED, GL_FLOAT, NULL);
+		}
+		else
+		{
+			// See field.glsl for the packing.
+			uint32_t voxels_per_word = 1;
+			if(field_precision == FIELD_PRECISION_FP16)
+			{
+				voxels_per_word = 2;
+			}
+			else if(field_precision == FIELD_PRECISION_UNORM8)
+			{
+				voxels_per_word = 4;
+			}
+			uint32_t field_words = (grid_volume + voxels_per_word - 1) / voxels_per_word;
+
+			int64_t max_ssbo_size;
+			glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &max_ssbo_size);
+			if(sizeof(uint32_t) * field_words > max_ssbo_size)
+			{
+				panic();
+			}
+
+			// All zero bits are a color of 0 at every precision.
+			uint32_t zero = 0;
+			gl_reallocate_buffer(resources, state, gl->color_buffers[i], sizeof(uint32_t) * field_words, NULL, 0);
+			glClearNamedBufferData(gl_buffer(resources, gl->color_buffers[i]), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+		}
+	}
+
+	gl->field_length = grid_length;
+	gl->field_precision = field_precision;
+	gl->field_front = 0;
+	gl->dispatched_grid_length = 0;
+}
+
+// Binds the front field for reading and the back field for the mode kernel to
+// write, see field.glsl.
+void gl_bind_field(GlContext* gl)
+{
+	GlState* state = &gl->state;
+	uint32_t back = 1 - gl->field_front;
+
+	if(gl->options.field_storage == FIELD_STORAGE_IMAGE)
+	{
+		gl_state_bind_texture(state, FIELD_TEXTURE_UNIT, GL_TEXTURE_3D, gl->field_storage_textures[gl->field_front]);
+		gl_state_bind_image(state, FIELD_IMAGE_UNIT, gl->field_storage_textures[back], GL_WRITE_ONLY, GL_R16F);
+	}
+	else
+	{
+		gl_state_bind_buffer_base(state, GL_SHADER_STORAGE_BUFFER, FIELD_FRONT_SSBO_SLOT, gl_buffer(&gl->resources, gl->color_buffers[gl->field_front]));
+		gl_state_bind_buffer_base(state, GL_SHADER_STORAGE_BUFFER, FIELD_BACK_SSBO_SLOT, gl_buffer(&gl->resources, gl->color_buffers[back]));
+	}
+}
+
+// The barrier bits for reading a field, wherever it's stored.
+uint32_t gl_field_barrier_bits(GlContext* gl)
+{
+	if(gl->options.field_storage == FIELD_STORAGE_IMAGE)
+	{
+		return GL_TEXTURE_FETCH_BARRIER_BIT;
+	}
+	return GL_SHADER_STORAGE_BARRIER_BIT;
+}
+
+// (Re)allocates every buffer sized by the grid besides the field for
+// grid_length, growing or shrinking them as modes with different grid sizes
+// come and go. Their contents are lost, so the sort table is rebuilt and every
+// brick dispatched on the next use.
+void gl_resize_grid_buffers(GlContext* gl, uint32_t grid_length)
+{
+	GlResources* resources = &gl->resources;
+	GlState* state = &gl->state;
+
+	uint32_t grid_volume = grid_length * grid_length * grid_length;
+	uint32_t brick_length = grid_length / 4;
+	uint32_t brick_count = brick_length * brick_length * brick_length;
+
+	// Holds back to front orderings for the current grid size, one after the
+	// other, each starting on a valid SSBO offset. Only the range for the
+	// current camera is bound. Every ordering is kept if they fit, otherwise
+	// just the current one. See gl_build_sort_table.
+	int32_t ssbo_alignment;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &ssbo_alignment);
+	uint32_t sort_table_stride = sizeof(int32_t) * grid_volume;
+	sort_table_stride = (sort_table_stride + ssbo_alignment - 1) / ssbo_alignment * ssbo_alignment;
+
+	gl->sort_table_stride = sort_table_stride;
+	gl->sort_table_slots = SORT_PERMUTATIONS_COUNT;
+	if((uint64_t)sort_table_stride * SORT_PERMUTATIONS_COUNT > SORT_TABLE_MAX_SIZE)
+	{
+		gl->sort_table_slots = 1;
+	}
+	gl->sort_table_grid_length = 0;
+	gl->sort_permutation = SORT_PERMUTATIONS_COUNT;
+
+	gl_reallocate_buffer(resources, state, gl->instance_to_voxel_buffer, (int64_t)sort_table_stride * gl->sort_table_slots, NULL, 0);
+
+	// Only ever written by compact.comp.
+	gl_reallocate_buffer(resources, state, gl->visible_voxel_buffer, sizeof(int32_t) * grid_volume, NULL, 0);
+	gl_state_bind_buffer_base(state, GL_SHADER_STORAGE_BUFFER, 3, gl_buffer(resources, gl->visible_voxel_buffer));
+
+	uint32_t compact_blocks = (grid_volume + COMPACT_BLOCK_SIZE - 1) / COMPACT_BLOCK_SIZE;
+	gl_reallocate_buffer(resources, state, gl->compact_block_buffer, sizeof(uint32_t) * compact_blocks, NULL, 0);
+	gl_state_bind_buffer_base(state, GL_SHADER_STORAGE_BUFFER, 4, gl_buffer(resources, gl->compact_block_buffer));
+
+	// Occupied bits, then varying bits, see bricks.glsl.
+	uint32_t brick_words = (brick_count + 31) / 32;
+
+	gl_reallocate_buffer(resources, state, gl->brick_buffer, sizeof(uint32_t) * brick_words * 2, NULL, 0);
+	gl_state_bind_buffer_base(state, GL_SHADER_STORAGE_BUFFER, 6, gl_buffer(resources, gl->brick_buffer));
+
+	// The brick list and its group count are filled in on the GPU after each
+	// dispatch of the mode kernel, see gl_dispatch_mode.
+	BrickDispatch brick_dispatch = { .bricks_count = 0, .dispatch = { .num_groups_x = 0, .num_groups_y = 0, .num_groups_z = 1 } };
+
+	gl_reallocate_buffer(resources, state, gl->brick_dispatch_buffer, sizeof(BrickDispatch) + sizeof(uint32_t) * brick_count, NULL, GL_DYNAMIC_STORAGE_BIT);
+	glNamedBufferSubData(gl_buffer(resources, gl->brick_dispatch_buffer), 0, sizeof(brick_dispatch), &brick_dispatch);
+	gl_state_bind_buffer_base(state, GL_SHADER_STORAGE_BUFFER, 7, gl_buffer(resources, gl->brick_dispatch_buffer));
+	gl->dispatched_grid_length = 0;
+
+	gl->grid_buffers_length = grid_length;
+}
+
+// Lists the bricks the mode kernel changed last frame for this frame's
+// indirect dispatch, group_bricks to a workgroup, see gl_dispatch_mode.
+// Expects the voxel ubo to already be bound.
+void gl_list_bricks(GlContext* gl, uint32_t grid_length, uint32_t group_bricks)
+{
+	GlBarriers* barriers = &gl->barriers;
+	uint32_t brick_length = grid_length / 4;
+	uint32_t brick_count = brick_length * brick_length * brick_length;
+
+	// bricks_count, num_groups_x and num_groups_y.
+	uint32_t zero = 0;
+	glClearNamedBufferSubData(gl_buffer(&gl->resources, gl->brick_dispatch_buffer), GL_R32UI, 0, sizeof(uint32_t) * 3, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+	gl_barriers_read(barriers, BARRIER_BRICKS, GL_SHADER_STORAGE_BARRIER_BIT);
+	gl_barriers_flush(barriers);
+
+	gl_use_program(gl, gl->brick_list_program);
+	glUniform1i(0, group_bricks);
+	glUniform1i(1, gl->max_groups_x);
+	glDispatchCompute((brick_count + 63) / 64, 1, 1);
+	gl_barriers_write(barriers, BARRIER_BRICK_DISPATCH);
+}
+
+// Runs the current mode's kernel into the back field, one workgroup per block
+// of bricks of the size it was tuned to, see mode.glsl. Expects the voxel ubo
+// and the fields to already be bound, and the bricks to already be listed.
+//
+// Nothing else this frame reads what the kernel writes, so it's only waited on
+// by next frame's first barrier and overlaps every draw issued after it. For
+// that to hold, anything those draws read must be flushed by the time it's
+// issued, which happens here along with what the kernel itself reads.
+//
+// Bricks that held still this frame, and whose neighbors all did too, are
+// assumed to hold still next frame as long as the mode's data doesn't change,
+// so usually only the listed bricks are dispatched again. Content moving more
+// than a brick in a frame, or appearing out of nowhere, is still only caught
+// every BRICK_REFRESH_FRAMES. Bricks not dispatched are left as they are in
+// the back field, which matches the front field for every brick that held
+// still.
+void gl_dispatch_mode(GlContext* gl, Game* game, uint32_t grid_length)
+{
+	GlBarriers* barriers = &gl->barriers;
+
+	bool dispatch_all = gl->frame_index % BRICK_REFRESH_FRAMES == 0
+		|| gl->dispatched_mode != game->current_mode
+		|| gl->dispatched_grid_length != grid_length
+		|| memcmp(gl->dispatched_mode_data, game->mode_data, sizeof(game->mode_data)) != 0;
+
+	gl->dispatched_mode = game->current_mode;
+	gl->dispatched_grid_length = grid_length;
+	memcpy(gl->dispatched_mode_data, game->mode_data, sizeof(game->mode_data));
+
+	// Each voxel is compared against the front field to flag changed bricks.
+	gl_barriers_read(barriers, BARRIER_FIELD + gl->field_front, gl_field_barrier_bits(gl));
+	if(!dispatch_all)
+	{
+		gl_barriers_read(barriers, BARRIER_BRICK_DISPATCH, GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+	}
+	gl_barriers_flush(barriers);
+
+	uint32_t variant = gl_grid_variant(grid_length);
+	gl_use_program(gl, gl->mode_programs[game->current_mode][variant]);
+	glUniform1i(0, !dispatch_all);
+	if(dispatch_all)
+	{
+		uint32_t groups[3];
+		gl_mode_groups(grid_length, gl->mode_group_sizes[game->current_mode][variant], groups);
+		glDispatchCompute(groups[0], groups[1], groups[2]);
+	}
+	else
+	{
+		gl_state_bind_buffer(&gl->state, GL_DISPATCH_INDIRECT_BUFFER, gl_buffer(&gl->resources, gl->brick_dispatch_buffer));
+		glDispatchComputeIndirect(offsetof(BrickDispatch, dispatch));
+	}
+
+	gl_barriers_write(barriers, BARRIER_FIELD + 1 - gl->field_front);
+	gl_barriers_write(barriers, BARRIER_BRICKS);
+}
+
+// Writes the ordering for sort_permutation into slot of the instance to voxel
+// table. Expects the voxel ubo to already be bound.
+void gl_build_sort_ordering(GlContext* gl, uint32_t grid_length, uint32_t sort_permutation, uint32_t slot)
+{
+	gl_use_program(gl, gl->sort_program);
+	gl_state_bind_buffer_base(&gl->state, GL_SHADER_STORAGE_BUFFER, 1, gl_buffer(&gl->resources, gl->instance_to_voxel_buffer));
+	glUniform1i(0, sort_permutation);
+	glUniform1i(1, slot * (gl->sort_table_stride / sizeof(int32_t)));
+	glDispatchCompute(grid_length / 4, grid_length / 4, grid_length / 4);
+	gl_barriers_write(&gl->barriers, BARRIER_SORT_TABLE);
+}
+
+// Fills the instance to voxel table with every ordering for the grid length,
+// expecting the voxel ubo to already be bound with that grid length. With only
+// the one slot, orderings are instead built as the camera needs them, see
+// gl_compact_voxels.
+void gl_build_sort_table(GlContext* gl, uint32_t grid_length)
+{
+	if(gl->sort_table_slots == SORT_PERMUTATIONS_COUNT)
+	{
+		for(uint32_t i = 0; i < SORT_PERMUTATIONS_COUNT; i++)
+		{
+			gl_build_sort_ordering(gl, grid_length, i, i);
+		}
+	}
+
+	gl->sort_table_grid_length = grid_length;
+	gl->sort_permutation = SORT_PERMUTATIONS_COUNT;
+}
+
+// Fills the visible voxel buffer and the voxel draws, back to front, from the
+// front field. Expects the voxel ubo and the fields to already be bound.
+void gl_compact_voxels(GlContext* gl, uint32_t grid_length, float* cam_position)
+{
+	GlBarriers* barriers = &gl->barriers;
+	uint32_t grid_volume = grid_length * grid_length * grid_length;
+
+	// Select the back to front instance to voxel map
+	//
+	// Orderings are only built when the grid size changes. Past that, this is
+	// a rebind whenever the camera crosses into another octant or axis order,
+	// or a rebuild of the one slot for grids too big to keep every ordering.
+	if(gl->sort_table_grid_length != grid_length)
+	{
+		gl_build_sort_table(gl, grid_length);
+	}
+
+	uint32_t sort_permutation = voxel_sort_permutation(cam_position);
+	if(sort_permutation != gl->sort_permutation)
+	{
+		uint32_t slot = sort_permutation;
+		if(gl->sort_table_slots == 1)
+		{
+			gl_build_sort_ordering(gl, grid_length, sort_permutation, 0);
+			slot = 0;
+		}
+
+		gl_state_bind_buffer_range(&gl->state, GL_SHADER_STORAGE_BUFFER, 1, gl_buffer(&gl->resources, gl->instance_to_voxel_buffer), slot * gl->sort_table_stride, grid_volume * sizeof(int32_t));
+		gl->sort_permutation = sort_permutation;
+	}
+
+	// Compact visible voxels
+	//
+	// Walks the sorted instance map and keeps only the voxels above the
+	// visibility threshold and in a brick touching the view frustum, in order,
+	// writing the counts of the indirect draws as it goes. See compact.comp for
+	// the three passes.
+	uint32_t compact_groups = (grid_volume + COMPACT_BLOCK_SIZE - 1) / COMPACT_BLOCK_SIZE;
+
+	gl_use_program(gl, gl->compact_program);
+
+	gl_barriers_read(barriers, BARRIER_SORT_TABLE, GL_SHADER_STORAGE_BARRIER_BIT);
+	gl_barriers_read(barriers, BARRIER_BRICKS, GL_SHADER_STORAGE_BARRIER_BIT);
+	gl_barriers_read(barriers, BARRIER_FIELD + gl->field_front, gl_field_barrier_bits(gl));
+	gl_barriers_flush(barriers);
+	glUniform1i(0, 0);
+	glDispatchCompute(compact_groups, 1, 1);
+	gl_barriers_write(barriers, BARRIER_COMPACTION);
+
+	gl_barriers_read(barriers, BARRIER_COMPACTION, GL_SHADER_STORAGE_BARRIER_BIT);
+	gl_barriers_flush(barriers);
+	glUniform1i(0, 1);
+	glDispatchCompute(1, 1, 1);
+	gl_barriers_write(barriers, BARRIER_COMPACTION);
+
+	gl_barriers_read(barriers, BARRIER_COMPACTION, GL_SHADER_STORAGE_BARRIER_BIT);
+	gl_barriers_flush(barriers);
+	glUniform1i(0, 2);
+	glDispatchCompute(compact_groups, 1, 1);
+	gl_barriers_write(barriers, BARRIER_COMPACTION);
+}
+
+// Draws the compacted voxels once per view, in one draw call. Expects the
+// voxel ubo to already be bound and the voxels to already be compacted, see
+// gl_compact_voxels.
+void gl_draw_voxels_instanced(GlContext* gl, VoxelDraw* views, uint32_t views_count)
+{
+	for(uint32_t i = 0; i < views_count; i++)
+	{
+		gl_draw_batch_add_indirect(&gl->voxel_batch, gl->voxel_draw_buffer, offsetof(VoxelDraws, cubes), &views[i]);
+	}
+	gl_draw_batch_flush(&gl->voxel_batch, &gl->resources, &gl->state, &gl->upload_ring);
+}
+
+// As gl_draw_voxels_instanced.
+void gl_draw_voxels_splat(GlContext* gl, VoxelDraw* views, uint32_t views_count)
+{
+	for(uint32_t i = 0; i < views_count; i++)
+	{
+		gl_draw_batch_add_indirect(&gl->splat_batch, gl->voxel_draw_buffer, offsetof(VoxelDraws, splats), &views[i]);
+	}
+	gl_draw_batch_flush(&gl->splat_batch, &gl->resources, &gl->state, &gl->upload_ring);
+}
+
+// Fills the volume textures the raymarcher reads from the front field. Expects
+// the voxel ubo and the fields to already be bound.
+void gl_fill_volume_textures(GlContext* gl, uint32_t grid_length)
+{
+	GlBarriers* barriers = &gl->barriers;
+
+	if(gl->volume_grid_length != grid_length)
+	{
+		uint32_t brick_length = grid_length / 4;
+
+		// A field in an image is marched as is, with no copy.
+		if(gl->options.field_storage == FIELD_STORAGE_BUFFER)
+		{
+			gl_state_bind_texture(&gl->state, 0, GL_TEXTURE_3D, gl->field_texture);
+			glTexImage3D(GL_TEXTURE_3D, 0, GL_R32F, grid_length, grid_length, grid_length, 0, GL_RED, GL_FLOAT, NULL);
+			glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		}
+
+		gl_state_bind_texture(&gl->state, 0, GL_TEXTURE_3D, gl->brick_texture);
+		glTexImage3D(GL_TEXTURE_3D, 0, GL_R32F, brick_length, brick_length, brick_length, 0, GL_RED, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		gl->volume_grid_length = grid_length;
+	}
+
+	gl_use_program(gl, gl->volume_field_program);
+	if(gl->options.field_storage == FIELD_STORAGE_BUFFER)
+	{
+		gl_state_bind_image(&gl->state, 0, gl->field_texture, GL_WRITE_ONLY, GL_R32F);
+	}
+	gl_state_bind_image(&gl->state, 1, gl->brick_texture, GL_WRITE_ONLY, GL_R32F);
+
+	gl_barriers_read(barriers, BARRIER_FIELD + gl->field_front, gl_field_barrier_bits(gl));
+	gl_barriers_flush(barriers);
+	glDispatchCompute(grid_length / 4, grid_length / 4, grid_length / 4);
+	gl_barriers_write(barriers, BARRIER_VOLUME);
+}
+
+// Expects the voxel ubo to already be bound and the volume textures to already
+// be filled, see gl_fill_volume_textures.
+void gl_draw_voxels_raymarched(GlContext* gl)
+{
+	uint32_t field_texture = gl->field_texture;
+	if(gl->options.field_storage == FIELD_STORAGE_IMAGE)
+	{
+		field_texture = gl->field_storage_textures[gl->field_front];
+	}
+
+	gl_use_program(gl, gl->volume_program);
+
+	gl_state_bind_texture(&gl->state, 1, GL_TEXTURE_3D, field_texture);
+	gl_state_bind_texture(&gl->state, 2, GL_TEXTURE_3D, gl->brick_texture);
+
+	gl_bind_vertex_array(gl, gl->volume_vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+// Expects the voxel ubo to already be bound.
+void gl_draw_voxels_oit(GlContext* gl, uint32_t grid_length, VoxelDraw* views, uint32_t views_count, uint32_t width, uint32_t height)
+{
+	if(gl->oit_width != width || gl->oit_height != height)
+	{
+		gl_state_bind_texture(&gl->state, 0, GL_TEXTURE_2D, gl->oit_accumulation_texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		gl_state_bind_texture(&gl->state, 0, GL_TEXTURE_2D, gl->oit_revealage_texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		gl_state_bind_framebuffer(&gl->state, gl->oit_framebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gl->oit_accumulation_texture, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gl->oit_revealage_texture, 0);
+		uint32_t draw_buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glDrawBuffers(2, draw_buffers);
+		if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			panic();
+		}
+
+		gl->oit_width = width;
+		gl->oit_height = height;
+	}
+
+	// Accumulate
+	//
+	// Every voxel is drawn in index order. Nothing is sorted or compacted, and
+	// blending takes care of the rest.
+	gl_state_bind_framebuffer(&gl->state, gl->oit_framebuffer);
+
+	float accumulation_clear[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float revealage_clear[] = { 1.0f, 0.0f, 0.0f, 0.0f };
+	glClearBufferfv(GL_COLOR, 0, accumulation_clear);
+	glClearBufferfv(GL_COLOR, 1, revealage_clear);
+
+	gl_state_set_depth_test(&gl->state, false);
+	glBlendFunci(0, GL_ONE, GL_ONE);
+	glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+
+	DrawArraysIndirectCommand command = { .count = VOXEL_VERTICES_COUNT, .instance_count = grid_length * grid_length * grid_length, .first = 0, .base_instance = 0 };
+	for(uint32_t i = 0; i < views_count; i++)
+	{
+		gl_draw_batch_add(&gl->voxel_oit_batch, &command, &views[i]);
+	}
+	gl_draw_batch_flush(&gl->voxel_oit_batch, &gl->resources, &gl->state, &gl->upload_ring);
+
+	// Resolve
+	gl_state_bind_framebuffer(&gl->state, 0);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	gl_use_program(gl, gl->oit_resolve_program);
+
+	gl_state_bind_texture(&gl->state, 1, GL_TEXTURE_2D, gl->oit_accumulation_texture);
+	gl_state_bind_texture(&gl->state, 2, GL_TEXTURE_2D, gl->oit_revealage_texture);
+
+	gl_bind_vertex_array(gl, gl->volume_vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	gl_state_set_depth_test(&gl->state, true);
+}
+
+// Uploads the runs of chars flagged dirty in the text layout, if any are, and
+// clears the flags. Runs closer than TEXT_DIRTY_GAP chars apart are uploaded
+// together.
+void gl_upload_text(GlContext* gl)
+{
+	TextLayout* text_layout = &gl->text_layout;
+	gl->text_upload_size = 0;
+
+	uint32_t i = 0;
+	while(i < text_layout->count)
+	{
+		if(text_layout->dirty[i / 32] == 0)
+		{
+			i = (i / 32 + 1) * 32;
+			continue;
+		}
+		if((text_layout->dirty[i / 32] & (1u << (i % 32))) == 0)
+		{
+			i++;
+			continue;
+		}
+
+		uint32_t run_first = i;
+		uint32_t run_last = i;
+		for(i++; i < text_layout->count && i <= run_last + TEXT_DIRTY_GAP; i++)
+		{
+			if((text_layout->dirty[i / 32] & (1u << (i % 32))) != 0)
+			{
+				run_last = i;
+			}
+		}
+		i = run_last + 1;
+
+		uint32_t run_size = sizeof(TextChar) * (run_last - run_first + 1);
+		glNamedBufferSubData(gl_buffer(&gl->resources, gl->text_buffer), sizeof(TextChar) * run_first, run_size, &text_layout->chars[run_first]);
+		gl->text_upload_size += run_size;
+	}
+
+	memset(text_layout->dirty, 0, sizeof(text_layout->dirty));
+}
+
+// Fields in an image are always fp16.
+uint8_t gl_field_precision(GlContext* gl, Mode* mode)
+{
+	if(gl->options.field_storage == FIELD_STORAGE_IMAGE)
+	{
+		return FIELD_PRECISION_FP16;
+	}
+	return mode->field_precision;
+}
+
+// The GPU time of one dispatch of the mode's kernel over the whole grid, at
+// the workgroup size of group_size bricks, in ns. Expects the field, the
+// brick buffers and the ubos to be set up for grid_length. A kernel that
+// doesn't build takes forever.
+uint64_t gl_time_mode_kernel(GlContext* gl, Game* game, uint8_t mode, uint32_t grid_length, uint8_t* group_size, uint32_t query)
+{
+	char* filename = game->modes[mode].compute_filename;
+	GLenum type = GL_COMPUTE_SHADER;
+	char defines[SHADER_VARIANT_DEFINES_MAX];
+	gl_mode_program_defines(grid_length, group_size, defines);
+
+	PendingProgram pending;
+	char error[SHADER_ERROR_MAX];
+	if(!gl_begin_program(gl, &filename, &type, 1, defines, &pending, error)
+		|| !gl_link_program(gl, &pending, error))
+	{
+		printf("%s", error);
+		return UINT64_MAX;
+	}
+	gl_apply_uniform_block(pending.program, "in_ubo", UBO_SLOT_MODE);
+	gl_apply_uniform_block(pending.program, "in_voxel_ubo", UBO_SLOT_VOXEL);
+
+	gl_state_use_program(&gl->state, pending.program);
+	glUniform1i(0, false);
+
+	uint32_t groups[3];
+	gl_mode_groups(grid_length, group_size, groups);
+	glDispatchCompute(groups[0], groups[1], groups[2]);
+
+	glFinish();
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	glBeginQuery(GL_TIME_ELAPSED, query);
+	for(uint32_t i = 0; i < TUNE_DISPATCHES; i++)
+	{
+		glDispatchCompute(groups[0], groups[1], groups[2]);
+	}
+	glEndQuery(GL_TIME_ELAPSED);
+
+	glFinish();
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	// Some drivers, llvmpipe for one, leave compute work out of timer queries,
+	// in which case the wall clock has to do.
+	uint64_t elapsed_ns;
+	glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed_ns);
+	if(elapsed_ns < TUNE_QUERY_MIN_NS)
+	{
+		elapsed_ns = (end.tv_sec - start.tv_sec) * 1000000000ull + end.tv_nsec - start.tv_nsec;
+	}
+
+	gl_state_forget_program(&gl->state, pending.program);
+	glDeleteProgram(pending.program);
+	return elapsed_ns / TUNE_DISPATCHES;
+}
+
+// Times every mode kernel at every grid length across mode_group_sizes, and
+// saves the fastest of each for the renderer, see kernel_tuning.c. Only full
+// dispatches are timed, with each mode's initial data, though most frames
+// only dispatch the bricks that changed. Run with --tune, in place of the
+// game, as it leaves the game and the context in no state to carry on.
+void gl_tune_mode_kernels(GlContext* gl, Game* game)
+{
+	uint32_t query;
+	glCreateQueries(GL_TIME_ELAPSED, 1, &query);
+
+	for(uint8_t mode = 0; mode < MODES_TMP_COUNT; mode++) // TODO - should just be 256 once all levels exist.
+	{
+		Mode* tuned_mode = &game->modes[mode];
+		mode_init(tuned_mode, game->mode_data);
+
+		for(uint32_t grid_length = GRID_MIN_LENGTH; grid_length <= GRID_MAX_LENGTH; grid_length *= 2)
+		{
+			gl_resize_grid_buffers(gl, grid_length);
+			gl_resize_field(gl, grid_length, gl_field_precision(gl, tuned_mode));
+			gl_bind_field(gl);
+
+			UploadRing* upload_ring = &gl->upload_ring;
+			upload_ring_begin_frame(upload_ring);
+
+			VoxelUbo voxel_ubo;
+			memset(&voxel_ubo, 0, sizeof(voxel_ubo));
+			voxel_ubo.grid_length = grid_length;
+			voxel_ubo.visibility_threshold = VOXEL_VISIBILITY_THRESHOLD;
+			voxel_ubo.field_precision = gl->field_precision;
+			uint32_t voxel_ubo_offset = upload_ring_push(upload_ring, &voxel_ubo, sizeof(voxel_ubo));
+			gl_state_bind_buffer_range(&gl->state, GL_UNIFORM_BUFFER, UBO_SLOT_VOXEL, upload_ring->buffer, voxel_ubo_offset, sizeof(voxel_ubo));
+
+			ModeUbo mode_ubo;
+			mode_ubo.time = 0.0f;
+			memcpy(mode_ubo.data, game->mode_data, sizeof(game->mode_data));
+			uint32_t mode_ubo_offset = upload_ring_push(upload_ring, &mode_ubo, sizeof(mode_ubo));
+			gl_state_bind_buffer_range(&gl->state, GL_UNIFORM_BUFFER, UBO_SLOT_MODE, upload_ring->buffer, mode_ubo_offset, sizeof(mode_ubo));
+
+			uint32_t fastest = 0;
+			uint64_t times_ns[MODE_GROUP_SIZES_COUNT];
+			for(uint32_t i = 0; i < MODE_GROUP_SIZES_COUNT; i++)
+			{
+				times_ns[i] = gl_time_mode_kernel(gl, game, mode, grid_length, mode_group_sizes[i], query);
+				if(times_ns[i] < times_ns[fastest])
+				{
+					fastest = i;
+				}
+			}
+
+			upload_ring_end_frame(upload_ring);
+
+			uint8_t* group_size = mode_group_sizes[fastest];
+			printf("%s %u^3: %ux%ux%u bricks, %.3f ms (1x1x1 %.3f ms)\n", tuned_mode->compute_filename, grid_length, group_size[0], group_size[1], group_size[2], times_ns[fastest] / 1000000.0f, times_ns[0] / 1000000.0f);
+			kernel_tuning_set(&gl->kernel_tuning, tuned_mode->compute_filename, grid_length, group_size);
+			memcpy(gl->mode_group_sizes[mode][gl_grid_variant(grid_length)], group_size, 3);
+		}
+	}
+
+	glDeleteQueries(1, &query);
+	kernel_tuning_save(&gl->kernel_tuning);
 }
 
 void gl_loop(GlContext* gl, Game* game, float window_width, float window_height)
 {
+	UploadRing* upload_ring = &gl->upload_ring;
+	upload_ring_begin_frame(upload_ring);
+
+	gl_update_mode_programs(gl, game);
+	gl_reload_programs(gl);
+
 	// Gl render
 	glClearColor(0.84, 0.84, 0.84, 1);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	// Game mode specific settings
 	Mode* mode = &game->modes[game->current_mode];
-	uint32_t mode_program = gl->mode_programs[game->current_mode];
 
 	uint32_t grid_length = mode->grid_length;
-	uint32_t grid_area = grid_length * grid_length;
-	uint32_t grid_volume = grid_length * grid_area;
-
-	// Update buffer
-	ModeUbo mode_ubo;
-	mode_ubo.time = game->time_since_init;
-	memcpy(mode_ubo.data, game->mode_data, sizeof(game->mode_data));
-	
-	glBindBuffer(GL_UNIFORM_BUFFER, gl->mode_data_ubo_buffer);
-	void* p_mode_data_ubo = glMapBuffer(GL_UNIFORM_BUFFER, GL_WRITE_ONLY);
-	memcpy(p_mode_data_ubo, &mode_ubo, sizeof(ModeUbo));
-	glUnmapBuffer(GL_UNIFORM_BUFFER);
-
-	// Dispatch compute program
-	glUseProgram(mode_program);
-	uint32_t mode_data_ubo_block_index = glGetUniformBlockIndex(mode_program, "ubo");
-	glBindBufferBase(GL_UNIFORM_BUFFER, 1, gl->mode_data_ubo_buffer);
-	glUniformBlockBinding(mode_program, mode_data_ubo_block_index, 0);
+	if(grid_length != gl->grid_buffers_length)
+	{
+		gl_resize_grid_buffers(gl, grid_length);
+	}
 
-	glDispatchCompute(grid_length / 4, grid_length / 4, grid_length / 4);
-	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	uint8_t field_precision = gl_field_precision(gl, mode);
+	if(grid_length != gl->field_length || field_precision != gl->field_precision)
+	{
+		gl_resize_field(gl, grid_length, field_precision);
+	}
 
 	// Update voxel ubo
 	VoxelUbo voxel_ubo;
 	voxel_ubo.grid_length = grid_length;
+	voxel_ubo.visibility_threshold = VOXEL_VISIBILITY_THRESHOLD;
+	voxel_ubo.field_precision = field_precision;
 
 	mat4 perspective;
 	glm_perspective(glm_rad(75.0f), window_width / window_height, 0.05f, 100.0f, perspective);
@@ -360,44 +1845,137 @@ void gl_loop(GlContext* gl, Game* game, float window_width, float window_height)
 	glm_lookat((float*)&game->cam_position, (float*)&cam_target, (float*)&up, view);
 
 	glm_mat4_mul(perspective, view, voxel_ubo.projection);
+	glm_mat4_inv(voxel_ubo.projection, voxel_ubo.inverse_projection);
+	v3_copy(game->cam_position, voxel_ubo.camera_position);
+	glm_frustum_planes(voxel_ubo.projection, voxel_ubo.frustum_planes);
 
-	glBindBuffer(GL_UNIFORM_BUFFER, gl->voxel_ubo_buffer);
-	void* p_voxel_ubo = glMapBuffer(GL_UNIFORM_BUFFER, GL_WRITE_ONLY);
-	memcpy(p_voxel_ubo, &voxel_ubo, sizeof(voxel_ubo));
-	glUnmapBuffer(GL_UNIFORM_BUFFER);
-
-	// Update instance to voxel map ssbo
-	int32_t instance_to_voxel_map[grid_volume];
-	float cam_pos[3];
-	v3_copy(game->cam_position, cam_pos);
+	// Every view the grid is drawn from. Compaction sorts and culls for the
+	// camera alone, so any others see what it sees.
+	VoxelDraw views[1];
+	glm_mat4_copy(voxel_ubo.projection, views[0].projection);
+	v3_copy(game->cam_position, views[0].camera_position);
+	views[0].splat_scale = window_height * perspective[1][1] / 2.0f;
+	uint32_t views_count = 1;
 
-	sort_voxels(instance_to_voxel_map, grid_length, grid_area, grid_volume, cam_pos);
+	uint32_t voxel_ubo_offset = upload_ring_push(upload_ring, &voxel_ubo, sizeof(voxel_ubo));
+	gl_state_bind_buffer_range(&gl->state, GL_UNIFORM_BUFFER, UBO_SLOT_VOXEL, upload_ring->buffer, voxel_ubo_offset, sizeof(voxel_ubo));
 
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl->instance_to_voxel_buffer);
-	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(instance_to_voxel_map), instance_to_voxel_map);
+	// Update buffer
+	ModeUbo mode_ubo;
+	mode_ubo.time = game->time_since_init;
+	memcpy(mode_ubo.data, game->mode_data, sizeof(game->mode_data));
+	
+	uint32_t mode_ubo_offset = upload_ring_push(upload_ring, &mode_ubo, sizeof(mode_ubo));
+	gl_state_bind_buffer_range(&gl->state, GL_UNIFORM_BUFFER, UBO_SLOT_MODE, upload_ring->buffer, mode_ubo_offset, sizeof(mode_ubo));
 
 	// Draw grid
-	glUseProgram(gl->voxel_program);
+	//
+	// Everything this frame draws from the front field, which last frame's
+	// mode kernel wrote, while this frame's kernel writes the back field. The
+	// frame runs in the order:
+	//
+	// 1. The bricks last frame's kernel changed are listed.
+	// 2. The renderer's compute passes read the front field.
+	// 3. The mode kernel is dispatched, with one barrier covering both what it
+	//    reads and what the draws after it read.
+	// 4. The renderer draws, then the text, all without a barrier, so they
+	//    overlap the mode kernel.
+	//
+	// Swapping the fields at the end leaves next frame's first barrier to wait
+	// on the kernel. The barrier in 3 also keeps the kernel from rewriting the
+	// brick occupancy bits while compaction is still reading them.
+	//
+	// The whole voxel pass, mode kernel included, is timed on the GPU so
+	// renderers can be compared. Each query is read back a few frames later so
+	// it never stalls.
+	gl_bind_field(gl);
+	gl_barriers_read(&gl->barriers, BARRIER_FIELD + gl->field_front, gl_field_barrier_bits(gl));
+
+	uint32_t voxel_timer_query = gl->voxel_timer_queries[gl->frame_index % VOXEL_TIMER_QUERIES_COUNT];
+	if(gl->frame_index >= VOXEL_TIMER_QUERIES_COUNT)
+	{
+		int32_t available;
+		glGetQueryObjectiv(voxel_timer_query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if(available)
+		{
+			uint64_t elapsed_ns;
+			glGetQueryObjectui64v(voxel_timer_query, GL_QUERY_RESULT, &elapsed_ns);
+			gl->voxel_pass_ms = elapsed_ns / 1000000.0f;
+		}
+	}
+	glBeginQuery(GL_TIME_ELAPSED, voxel_timer_query);
 
-	uint32_t voxel_ubo_block_index = glGetUniformBlockIndex(gl->voxel_program, "ubo");
-	glBindBufferBase(GL_UNIFORM_BUFFER, 0, gl->voxel_ubo_buffer);
-	glUniformBlockBinding(gl->voxel_program, voxel_ubo_block_index, 0);
+	uint8_t renderer = mode->renderer;
+	if(renderer == VOXEL_RENDERER_AUTO)
+	{
+		renderer = VOXEL_RENDERER_INSTANCED;
+		if(grid_length * grid_length * grid_length >= SPLAT_AUTO_VOLUME)
+		{
+			renderer = VOXEL_RENDERER_SPLAT;
+		}
+	}
 
-	glBindVertexArray(gl->voxel_vao);
-	glDrawArraysInstanced(GL_TRIANGLES, 0, 36, grid_volume);
+	if(gl->dispatched_grid_length == grid_length)
+	{
+		uint8_t* group_size = gl->mode_group_sizes[game->current_mode][gl_grid_variant(grid_length)];
+		gl_list_bricks(gl, grid_length, group_size[0] * group_size[1] * group_size[2]);
+	}
 
-	// Update text ubo
-	TextUbo text_ubo;	
-	float text_scale_x = 27.0f / window_width;
-	float text_scale_y = 46.0f / window_height;
-	
-	v2_init(text_ubo.transform_a, text_scale_x,  0);
-	v2_init(text_ubo.transform_b, 0, -text_scale_y);
+	switch(renderer)
+	{
+		case VOXEL_RENDERER_INSTANCED:
+		case VOXEL_RENDERER_SPLAT:
+		{
+			gl_compact_voxels(gl, grid_length, game->cam_position);
+			gl_barriers_read(&gl->barriers, BARRIER_COMPACTION, GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+			break;
+		}
+		case VOXEL_RENDERER_RAYMARCHED:
+		{
+			gl_fill_volume_textures(gl, grid_length);
+			gl_barriers_read(&gl->barriers, BARRIER_VOLUME, GL_TEXTURE_FETCH_BARRIER_BIT);
+			break;
+		}
+		default: break;
+	}
+
+	uint8_t mode_program_state = gl->mode_program_states[game->current_mode][gl_grid_variant(grid_length)];
+	bool mode_program_ready = mode_program_state == MODE_PROGRAM_READY;
+	if(mode_program_ready)
+	{
+		gl_dispatch_mode(gl, game, grid_length);
+	}
 
-	glBindBuffer(GL_UNIFORM_BUFFER, gl->text_ubo_buffer);
-	void* p_text_ubo = glMapBuffer(GL_UNIFORM_BUFFER, GL_WRITE_ONLY);
-	memcpy(p_text_ubo, &text_ubo, sizeof(text_ubo));
-	glUnmapBuffer(GL_UNIFORM_BUFFER);
+	// Already done by gl_dispatch_mode, unless the kernel is still building.
+	gl_barriers_flush(&gl->barriers);
+
+	switch(renderer)
+	{
+		case VOXEL_RENDERER_INSTANCED:
+		{
+			gl_draw_voxels_instanced(gl, views, views_count);
+			break;
+		}
+		case VOXEL_RENDERER_SPLAT:
+		{
+			gl_draw_voxels_splat(gl, views, views_count);
+			break;
+		}
+		case VOXEL_RENDERER_RAYMARCHED:
+		{
+			gl_draw_voxels_raymarched(gl);
+			break;
+		}
+		case VOXEL_RENDERER_OIT:
+		{
+			gl_draw_voxels_oit(gl, grid_length, views, views_count, window_width, window_height);
+			break;
+		}
+		default: break;
+	}
+
+	glEndQuery(GL_TIME_ELAPSED);
+	gl->frame_index++;
 
 	// Update text ssbo buffer
 	// 
@@ -412,40 +1990,104 @@ void gl_loop(GlContext* gl, Game* game, float window_width, float window_height)
 	// As a part of that, we will want to make the flow between levels and
 	// implement the level selector.
 	Mode* current_mode = &game->modes[game->current_mode];
-	TextChar text_buffer[TEXT_MAX_CHARS];
-
-	char desc_str[128];
-	float text_pos[2];
-
-	sprintf(desc_str, "%s", current_mode->compute_filename);
-	uint32_t text_i = fill_text_buffer(desc_str, text_buffer, v2_init(text_pos, 2.35f, 28.25f), 1.0f, 1.0f);
+	TextLayout* text_layout = &gl->text_layout;
+	Hud* hud = &gl->hud;
 
-	char* sub_desc_str = "This is just a small showcase of what our world, nay, our universe, is capable of.";
-	text_i += fill_text_buffer(sub_desc_str, &text_buffer[text_i], v2_init(text_pos, 4, 59), 0.5f, 1.0f);
-
-	char* space_prompt_str = "[Space]";
-	text_i += fill_text_buffer(space_prompt_str, &text_buffer[text_i], v2_init(text_pos, 49.8f, 36.0f), 0.66f, 1.0f - sin(game->time_since_init * 1.0f));
+	if(mode_program_ready)
+	{
+		text_object_set_string(text_layout, &hud->title, current_mode->compute_filename);
+	}
+	else
+	{
+		char title_str[128];
+		sprintf(title_str, "%s (%s)", current_mode->compute_filename, mode_program_state == MODE_PROGRAM_FAILED ? "error" : "compiling");
+		text_object_set_string(text_layout, &hud->title, title_str);
+	}
+	text_object_set_color(text_layout, &hud->space_prompt, 1.0f - sin(game->time_since_init * 1.0f));
 
 #define DIMLEN 7
-	for(uint8_t i = 0; i < current_mode->visible_dimensions; i++)
+	for(uint8_t i = 0; i < MAX_DIMENSIONS; i++)
 	{
-		char s[128];
-		sprintf(s, "[%i] %.1f", i, game->mode_data[i]);
-		text_i += fill_text_buffer(s, &text_buffer[text_i], v2_init(text_pos, 4, 2.5 + i * 1.5), 0.66f, 1.0f);
+		TextObject* dimension = &hud->dimensions[i];
+		if(i >= current_mode->visible_dimensions)
+		{
+			text_object_set_string(text_layout, dimension, "");
+		}
+		else if(dimension->length == 0 || game->mode_data[i] != hud->dimension_values[i])
+		{
+			char s[TEXT_OBJECT_MAX_LENGTH];
+			sprintf(s, "[%i] %.1f", i, game->mode_data[i]);
+			text_object_set_string(text_layout, dimension, s);
+			hud->dimension_values[i] = game->mode_data[i];
+		}
 	}
 
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl->text_buffer);
-	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(text_buffer), text_buffer);
+	float status_y = 4.5 + current_mode->visible_dimensions * 2.0f;
+
+	char* renderer_names[VOXEL_RENDERERS_COUNT] = { "auto", "instanced", "splat", "raymarched", "oit" };
+	char renderer_str[128];
+	if(current_mode->renderer == VOXEL_RENDERER_AUTO)
+	{
+		sprintf(renderer_str, "[V] auto (%s) %.2f ms", renderer_names[renderer], gl->voxel_pass_ms);
+	}
+	else
+	{
+		sprintf(renderer_str, "[V] %s %.2f ms", renderer_names[renderer], gl->voxel_pass_ms);
+	}
+	text_object_set_position(text_layout, &hud->renderer, 6, status_y);
+	text_object_set_string(text_layout, &hud->renderer, renderer_str);
+
+	char* field_precision_names[FIELD_PRECISIONS_COUNT] = { "fp32", "fp16", "unorm8" };
+	char precision_str[128];
+	sprintf(precision_str, "[P] %s", field_precision_names[field_precision]);
+	text_object_set_position(text_layout, &hud->precision, 6, status_y + 1.5f);
+	text_object_set_string(text_layout, &hud->precision, precision_str);
+
+	char* field_storage_names[] = { "buffer", "image" };
+	char* field_layout_names[] = { "linear", "morton" };
+	char grid_str[128];
+	sprintf(grid_str, "[[ ]] %u^3 %s %s, buffers %.1f MB", grid_length, field_storage_names[gl->options.field_storage], field_layout_names[gl->options.field_layout], gl->resources.buffer_bytes / (1024.0f * 1024.0f));
+	text_object_set_position(text_layout, &hud->grid, 6, status_y + 3.0f);
+	text_object_set_string(text_layout, &hud->grid, grid_str);
+
+	// From the last frame, as this one isn't done yet.
+	char gl_stats_str[128];
+	sprintf(gl_stats_str, "gl %u calls, %u elided, %u/%u barriers, text %u bytes", gl->state.last_frame_calls_issued, gl->state.last_frame_calls_elided, gl->barriers.last_frame_barriers_issued, gl->barriers.last_frame_barriers_issued + gl->barriers.last_frame_barriers_elided, gl->text_upload_size);
+	text_object_set_position(text_layout, &hud->gl_stats, 6, status_y + 4.5f);
+	text_object_set_string(text_layout, &hud->gl_stats, gl_stats_str);
+
+	// Only the first line of the log fits.
+	char shader_error_str[SHADER_ERROR_MAX];
+	uint32_t shader_error_length = strcspn(gl->shader_error, "\n");
+	memcpy(shader_error_str, gl->shader_error, shader_error_length);
+	shader_error_str[shader_error_length] = '\0';
+	text_object_set_position(text_layout, &hud->shader_error, 6, status_y + 6.0f);
+	text_object_set_string(text_layout, &hud->shader_error, shader_error_str);
+
+	gl_upload_text(gl);
+	gl_state_bind_buffer_base(&gl->state, GL_SHADER_STORAGE_BUFFER, 2, gl_buffer(&gl->resources, gl->text_buffer));
 
 	// Draw text
-	glUseProgram(gl->text_program);
+	//
+	// The whole layout is the one overlay for now. Others would each be a
+	// range of chars with a transform of their own, added to the same batch.
+	float text_scale_x = 27.0f / window_width;
+	float text_scale_y = 46.0f / window_height;
+
+	TextDraw hud_draw = { .transform = { text_scale_x, 0.0f, 0.0f, -text_scale_y }, .first_char = 0 };
+	DrawArraysIndirectCommand hud_command = { .count = 6, .instance_count = text_layout->count, .first = 0, .base_instance = 0 };
+	gl_draw_batch_add(&gl->text_batch, &hud_command, &hud_draw);
 
-	uint32_t text_ubo_block_index = glGetUniformBlockIndex(gl->text_program, "ubo");
-	glBindBufferBase(GL_UNIFORM_BUFFER, 0, gl->text_ubo_buffer);
-	glUniformBlockBinding(gl->text_program, text_ubo_block_index, 0);
+	gl_state_bind_texture(&gl->state, 0, GL_TEXTURE_2D, gl->font_texture);
+	gl_draw_batch_flush(&gl->text_batch, &gl->resources, &gl->state, &gl->upload_ring);
+
+	// What the mode kernel wrote is drawn next frame.
+	if(mode_program_ready)
+	{
+		gl->field_front = 1 - gl->field_front;
+	}
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gl->font_texture);
-	glBindVertexArray(gl->text_vao);
-	glDrawArraysInstanced(GL_TRIANGLES, 0, 6, text_i);
+	upload_ring_end_frame(upload_ring);
+	gl_state_end_frame(&gl->state);
+	gl_barriers_end_frame(&gl->barriers);
 }
@@ -0,0 +1,166 @@
+// Linked programs saved to disk with glGetProgramBinary and loaded back with
+// glProgramBinary, so a warm start never runs the GLSL compiler. Each program
+// is keyed by a hash of its sources, exactly as they would be compiled, along
+// with GL_RENDERER and GL_VERSION. Editing a shader or changing its defines,
+// the driver or the GPU makes for a different key, and so a miss.
+//
+// A binary the driver rejects anyway, which it's free to do at any time, is
+// also a miss. Either way the program is compiled from source and its entry
+// written over.
+
+#define PROGRAM_CACHE_DIRECTORY "shader_cache"
+#define PROGRAM_CACHE_MAGIC 0x42504446
+
+typedef struct
+{
+	uint32_t magic;
+	uint32_t binary_format;
+	uint64_t key;
+	uint32_t binary_length;
+} ProgramCacheHeader;
+
+typedef struct
+{
+	// False if the driver has no binary formats at all.
+	bool enabled;
+	uint64_t driver_hash;
+
+	uint32_t programs_loaded;
+	uint32_t programs_compiled;
+} ProgramCache;
+
+uint64_t hash_fnv1a(uint64_t hash, void* data, uint64_t size)
+{
+	uint8_t* bytes = data;
+	for(uint64_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001B3;
+	}
+	return hash;
+}
+
+#define HASH_FNV1A_BASIS 0xCBF29CE484222325
+
+void program_cache_init(ProgramCache* cache)
+{
+	int32_t binary_formats;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binary_formats);
+	cache->enabled = binary_formats > 0;
+
+	char* renderer = (char*)glGetString(GL_RENDERER);
+	char* version = (char*)glGetString(GL_VERSION);
+	cache->driver_hash = hash_fnv1a(HASH_FNV1A_BASIS, renderer, strlen(renderer) + 1);
+	cache->driver_hash = hash_fnv1a(cache->driver_hash, version, strlen(version) + 1);
+
+	cache->programs_loaded = 0;
+	cache->programs_compiled = 0;
+
+	// Failing because it already exists is fine. Failing for any other reason
+	// shows up as every store failing, which is also fine.
+	mkdir(PROGRAM_CACHE_DIRECTORY, 0755);
+}
+
+// sources are the full text of each stage, as passed to glShaderSource.
+uint64_t program_cache_key(ProgramCache* cache, char** sources, uint32_t sources_count)
+{
+	uint64_t key = cache->driver_hash;
+	for(uint32_t i = 0; i < sources_count; i++)
+	{
+		key = hash_fnv1a(key, sources[i], strlen(sources[i]) + 1);
+	}
+	return key;
+}
+
+void program_cache_filename(uint64_t key, char* filename)
+{
+	sprintf(filename, PROGRAM_CACHE_DIRECTORY "/%016llx.bin", (unsigned long long)key);
+}
+
+// Returns the linked program, or 0 on a miss.
+uint32_t program_cache_load(ProgramCache* cache, uint64_t key)
+{
+	if(!cache->enabled)
+	{
+		return 0;
+	}
+
+	char filename[64];
+	program_cache_filename(key, filename);
+	FILE* file = fopen(filename, "rb");
+	if(file == NULL)
+	{
+		return 0;
+	}
+
+	ProgramCacheHeader header;
+	void* binary = NULL;
+	uint32_t program = 0;
+	if(fread(&header, sizeof(header), 1, file) == 1 && header.magic == PROGRAM_CACHE_MAGIC && header.key == key)
+	{
+		binary = malloc(header.binary_length);
+		if(binary != NULL && fread(binary, header.binary_length, 1, file) == 1)
+		{
+			program = glCreateProgram();
+			glProgramBinary(program, header.binary_format, binary, header.binary_length);
+
+			int32_t success;
+			glGetProgramiv(program, GL_LINK_STATUS, &success);
+			if(success == false)
+			{
+				glDeleteProgram(program);
+				program = 0;
+			}
+		}
+	}
+
+	free(binary);
+	fclose(file);
+
+	if(program != 0)
+	{
+		cache->programs_loaded++;
+	}
+	return program;
+}
+
+// Expects the program to have been linked with
+// GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+void program_cache_store(ProgramCache* cache, uint64_t key, uint32_t program)
+{
+	cache->programs_compiled++;
+	if(!cache->enabled)
+	{
+		return;
+	}
+
+	int32_t binary_length;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binary_length);
+	if(binary_length <= 0)
+	{
+		return;
+	}
+
+	void* binary = malloc(binary_length);
+	if(binary == NULL)
+	{
+		panic();
+	}
+
+	ProgramCacheHeader header = { .magic = PROGRAM_CACHE_MAGIC, .key = key };
+	int32_t written_length;
+	glGetProgramBinary(program, binary_length, &written_length, &header.binary_format, binary);
+	header.binary_length = written_length;
+
+	char filename[64];
+	program_cache_filename(key, filename);
+	FILE* file = fopen(filename, "wb");
+	if(file != NULL)
+	{
+		fwrite(&header, sizeof(header), 1, file);
+		fwrite(binary, written_length, 1, file);
+		fclose(file);
+	}
+
+	free(binary);
+}
@@ -0,0 +1,45 @@
+// Watches the shader directory with inotify so shaders can be reloaded as
+// they're edited, see gl_reload_programs. Editors save by writing a file in
+// place or by writing another and renaming it over, so both are watched for.
+//
+// Only that something changed is reported, not what. Which programs it
+// affects, through includes or otherwise, is for the caller to work out.
+// If the directory can't be watched, nothing ever changes.
+
+typedef struct
+{
+	int32_t fd;
+} ShaderWatch;
+
+void shader_watch_init(ShaderWatch* watch, char* directory)
+{
+	watch->fd = inotify_init1(IN_NONBLOCK);
+	if(watch->fd < 0)
+	{
+		return;
+	}
+
+	if(inotify_add_watch(watch->fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+	{
+		close(watch->fd);
+		watch->fd = -1;
+	}
+}
+
+// Returns whether anything in the directory was written since the last poll.
+// Never blocks.
+bool shader_watch_poll(ShaderWatch* watch)
+{
+	if(watch->fd < 0)
+	{
+		return false;
+	}
+
+	bool changed = false;
+	char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	while(read(watch->fd, events, sizeof(events)) > 0)
+	{
+		changed = true;
+	}
+	return changed;
+}
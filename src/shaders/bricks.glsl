@@ -0,0 +1,51 @@
+// The brick occupancy map, one bit per 4x4x4 brick with bricks in the same x,
+// then y, then z order as voxels. The first brick_words(grid_length) words
+// flag bricks holding at least one voxel above the visibility threshold, the
+// words after that bricks which changed the last time the mode kernel ran on
+// them. Written by write_voxel, see mode.glsl.
+layout(std430, binding = 6) buffer brick_occupancy_buffer
+{
+	uint words[];
+} brick_buffer;
+
+// VOLATILE - this must match BrickDispatch in opengl.c.
+//
+// The bricks to run the mode kernel on next frame, group_bricks to a
+// workgroup of an indirect dispatch, the workgroups in rows along x. Filled by
+// bricks.comp.
+layout(std430, binding = 7) buffer brick_dispatch_buffer
+{
+	uint bricks_count;
+	uint num_groups_x;
+	uint num_groups_y;
+	uint num_groups_z;
+	uint bricks[];
+} brick_dispatch;
+
+int brick_words(int grid_length)
+{
+	int brick_length = grid_length / 4;
+	return (brick_length * brick_length * brick_length + 31) / 32;
+}
+
+int brick_index(ivec3 brick, int grid_length)
+{
+	int brick_length = grid_length / 4;
+	return brick.z * brick_length * brick_length + brick.y * brick_length + brick.x;
+}
+
+ivec3 brick_coordinates(int brick, int grid_length)
+{
+	int brick_length = grid_length / 4;
+	return ivec3(brick % brick_length, (brick / brick_length) % brick_length, brick / (brick_length * brick_length));
+}
+
+bool brick_occupied(int brick)
+{
+	return (brick_buffer.words[brick / 32] & (1u << (brick % 32))) != 0;
+}
+
+bool brick_varying(int brick, int grid_length)
+{
+	return (brick_buffer.words[brick_words(grid_length) + brick / 32] & (1u << (brick % 32))) != 0;
+}
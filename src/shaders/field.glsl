@@ -0,0 +1,172 @@
+// The mode's color field, one value per voxel. By default it's a flat buffer,
+// in the order of field_layout.glsl, of 32 bit words each packing one fp32,
+// two fp16 or four unorm8 voxels, see FIELD_PRECISION_*. With
+// FIELD_STORAGE_IMAGE it's instead an fp16 3D image, laid out however the
+// driver likes (in practice tiled, so neighbors in any direction tend to share
+// a cache line), written by the mode kernels with imageStore and read by
+// everything else as a texture. See gl_resize_field.
+//
+// The field is double buffered. Everything reads the front field, which the
+// mode kernel wrote last frame, while the mode kernel writes the back field
+// for next frame. See gl_dispatch_mode.
+//
+// The mode kernels define FIELD_WRITABLE before including this and use
+// field_quantize and field_store on top of the fetches. Everything else only
+// uses field_fetch or field_fetch_voxel. All of them take the grid length and
+// precision from the voxel ubo.
+//
+// VOLATILE - the bindings must match FIELD_BACK_SSBO_SLOT, FIELD_IMAGE_UNIT and
+// FIELD_TEXTURE_UNIT in opengl.c.
+
+// VOLATILE - these must match game.c.
+#define FIELD_PRECISION_FP32 0
+#define FIELD_PRECISION_FP16 1
+#define FIELD_PRECISION_UNORM8 2
+
+#ifdef FIELD_STORAGE_IMAGE
+layout(binding = 3) uniform sampler3D field_texture;
+#ifdef FIELD_WRITABLE
+layout(r16f, binding = 2) uniform writeonly image3D field_image;
+#endif
+#else
+layout(std430, binding = 0) readonly buffer in_color_buffer
+{
+	uint words[];
+} color_buffer;
+#ifdef FIELD_WRITABLE
+layout(std430, binding = 8) writeonly buffer out_color_buffer
+{
+	uint words[];
+} back_color_buffer;
+#endif
+#endif
+
+#include "field_layout.glsl"
+
+int field_voxels_per_word(int field_precision)
+{
+	if(field_precision == FIELD_PRECISION_FP16)
+	{
+		return 2;
+	}
+	if(field_precision == FIELD_PRECISION_UNORM8)
+	{
+		return 4;
+	}
+	return 1;
+}
+
+// The bits of color at its place in the word holding the voxel at index.
+uint field_pack(float color, int field_precision, int index)
+{
+	if(field_precision == FIELD_PRECISION_FP16)
+	{
+		return (packHalf2x16(vec2(color, 0.0f)) & 0xFFFFu) << ((index % 2) * 16);
+	}
+	if(field_precision == FIELD_PRECISION_UNORM8)
+	{
+		return (packUnorm4x8(vec4(color, 0.0f, 0.0f, 0.0f)) & 0xFFu) << ((index % 4) * 8);
+	}
+	return floatBitsToUint(color);
+}
+
+// The color of the voxel at index out of the word holding it.
+float field_unpack(uint word, int field_precision, int index)
+{
+	if(field_precision == FIELD_PRECISION_FP16)
+	{
+		return unpackHalf2x16(word >> ((index % 2) * 16)).x;
+	}
+	if(field_precision == FIELD_PRECISION_UNORM8)
+	{
+		return unpackUnorm4x8(word >> ((index % 4) * 8)).x;
+	}
+	return uintBitsToFloat(word);
+}
+
+float field_fetch_voxel(ivec3 voxel, int grid_length, int field_precision)
+{
+#ifdef FIELD_STORAGE_IMAGE
+	return texelFetch(field_texture, voxel, 0).r;
+#else
+	int index = field_index(voxel, grid_length);
+	return field_unpack(color_buffer.words[index / field_voxels_per_word(field_precision)], field_precision, index);
+#endif
+}
+
+float field_fetch(int voxel_id, int grid_length, int field_precision)
+{
+#ifdef FIELD_STORAGE_IMAGE
+	return texelFetch(field_texture, field_coordinates(voxel_id, grid_length), 0).r;
+#else
+	return field_unpack(color_buffer.words[voxel_id / field_voxels_per_word(field_precision)], field_precision, voxel_id);
+#endif
+}
+
+#ifdef FIELD_WRITABLE
+// Where each word is put together before being stored, see field_store. A
+// word for every invocation, so 64 for each brick of the workgroup.
+shared uint field_brick_words[gl_WorkGroupSize.x * gl_WorkGroupSize.y * gl_WorkGroupSize.z];
+
+// The nearest color the field can hold exactly.
+float field_quantize(float color, int field_precision)
+{
+#ifdef FIELD_STORAGE_IMAGE
+	return unpackHalf2x16(packHalf2x16(vec2(color, 0.0f))).x;
+#else
+	return field_unpack(field_pack(color, field_precision, 0), field_precision, 0);
+#endif
+}
+
+// Stores into the back field, unless valid is false. Must be called once by
+// every invocation of the workgroup, valid or not, in uniform control flow,
+// with the workgroup being a block of 4x4x4 bricks each holding the voxels of
+// one brick of the grid.
+//
+// The voxels sharing a word always share a brick too, in either layout, so
+// each word is put together in its brick's part of shared memory and stored
+// whole by its first voxel. Nothing in the buffer is written twice or
+// atomically.
+void field_store(ivec3 voxel, int grid_length, int field_precision, float color, bool valid)
+{
+#ifdef FIELD_STORAGE_IMAGE
+	if(valid)
+	{
+		imageStore(field_image, voxel, vec4(color));
+	}
+#else
+	int index = field_index(voxel, grid_length);
+	int voxels_per_word = field_voxels_per_word(field_precision);
+	if(voxels_per_word == 1)
+	{
+		if(valid)
+		{
+			back_color_buffer.words[index] = field_pack(color, field_precision, index);
+		}
+		return;
+	}
+
+	ivec3 group_bricks = ivec3(gl_WorkGroupSize) / 4;
+	ivec3 group_brick = ivec3(gl_LocalInvocationID) / 4;
+	int brick_slot = (group_brick.z * group_bricks.y + group_brick.y) * group_bricks.x + group_brick.x;
+
+	int first_index = index - index % voxels_per_word;
+	ivec3 first_voxel = field_coordinates(first_index, grid_length) % 4;
+	int slot = brick_slot * 64 + first_voxel.z * 16 + first_voxel.y * 4 + first_voxel.x;
+
+	field_brick_words[gl_LocalInvocationIndex] = 0;
+	barrier();
+
+	if(valid)
+	{
+		atomicOr(field_brick_words[slot], field_pack(color, field_precision, index));
+	}
+	barrier();
+
+	if(valid && index == first_index)
+	{
+		back_color_buffer.words[index / voxels_per_word] = field_brick_words[slot];
+	}
+#endif
+}
+#endif
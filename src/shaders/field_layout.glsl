@@ -0,0 +1,30 @@
+// Where each voxel of the field is, by index. By default indices run in x, then
+// y, then z order. With FIELD_LAYOUT_MORTON they instead follow a Z-order
+// curve, so voxels near each other in any direction are near each other in
+// memory, whichever way the grid is walked. Every 4x4x4 brick is then 64
+// consecutive indices. Only valid for power of two grid lengths, which they
+// all are.
+//
+// Voxel ids, as stored in the instance to voxel table and the visible voxel
+// buffer, are these indices.
+
+#include "morton.glsl"
+
+int field_index(ivec3 voxel, int grid_length)
+{
+#ifdef FIELD_LAYOUT_MORTON
+	return int(morton_encode(uint(voxel.x), uint(voxel.y), uint(voxel.z)));
+#else
+	return voxel.z * grid_length * grid_length + voxel.y * grid_length + voxel.x;
+#endif
+}
+
+ivec3 field_coordinates(int voxel_id, int grid_length)
+{
+#ifdef FIELD_LAYOUT_MORTON
+	uint code = uint(voxel_id);
+	return ivec3(morton_decode(code, 0u), morton_decode(code, 1u), morton_decode(code, 2u));
+#else
+	return ivec3(voxel_id % grid_length, (voxel_id / grid_length) % grid_length, voxel_id / (grid_length * grid_length));
+#endif
+}
@@ -0,0 +1,139 @@
+// Included by every mode kernel, which must get its voxel from mode_voxel and
+// store its color with write_voxel rather than touching the field.
+//
+// Each workgroup is a block of bricks, LOCAL_SIZE_X/Y/Z voxels across, which
+// is a single brick unless the kernel was tuned to more, see
+// gl_tune_mode_kernels. The kernel is either dispatched over the whole grid
+// or, through glDispatchComputeIndirect, over only the bricks that changed
+// last frame, in which case each workgroup takes consecutive bricks from the
+// dispatch list. Either way the last workgroups can run past the grid or the
+// list, and their invocations there store nothing. See gl_dispatch_mode.
+//
+// Each kernel is built for one grid length, GRID_LENGTH, so the index math on
+// it folds to constants. See gl_request_mode_program.
+layout (local_size_x = LOCAL_SIZE_X, local_size_y = LOCAL_SIZE_Y, local_size_z = LOCAL_SIZE_Z) in;
+
+#define FIELD_WRITABLE
+#include "field.glsl"
+
+#include "bricks.glsl"
+
+layout(std140, binding = 0) uniform in_voxel_ubo
+{
+	mat4 projection;
+	int grid_length;
+	float visibility_threshold;
+	int field_precision;
+} voxel_ubo;
+
+layout(location = 0) uniform bool dispatch_listed_bricks;
+
+const ivec3 group_bricks = ivec3(gl_WorkGroupSize) / 4;
+const int group_bricks_count = group_bricks.x * group_bricks.y * group_bricks.z;
+
+shared bool brick_occupied_bits[group_bricks_count];
+shared bool brick_varying_bits[group_bricks_count];
+
+// Which of the workgroup's bricks the invocation's voxel is in.
+int group_brick()
+{
+	ivec3 brick = ivec3(gl_LocalInvocationID) / 4;
+	return brick.z * group_bricks.x * group_bricks.y + brick.y * group_bricks.x + brick.x;
+}
+
+// Which workgroup of the dispatch list the invocation is in, the list's
+// workgroups being laid out in rows along x, see bricks.comp.
+int mode_group_index()
+{
+	return int(gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x);
+}
+
+// Whether the invocation has a voxel at all, rather than being past the end
+// of the grid or the dispatch list.
+bool mode_voxel_valid()
+{
+	if(dispatch_listed_bricks)
+	{
+		return mode_group_index() * group_bricks_count + group_brick() < int(brick_dispatch.bricks_count);
+	}
+	return all(lessThan(ivec3(gl_GlobalInvocationID), ivec3(GRID_LENGTH)));
+}
+
+ivec3 mode_voxel()
+{
+	ivec3 brick = ivec3(gl_WorkGroupID) * group_bricks + ivec3(gl_LocalInvocationID) / 4;
+	if(dispatch_listed_bricks)
+	{
+		int slot = mode_group_index() * group_bricks_count + group_brick();
+		brick = ivec3(0);
+		if(slot < int(brick_dispatch.bricks_count))
+		{
+			brick = brick_coordinates(int(brick_dispatch.bricks[slot]), GRID_LENGTH);
+		}
+	}
+	return brick * 4 + ivec3(gl_LocalInvocationID) % 4;
+}
+
+// Stores the color of mode_voxel and updates its brick's occupancy bits. Must
+// be called exactly once per invocation, in uniform control flow.
+void write_voxel(float color)
+{
+	ivec3 voxel = mode_voxel();
+	bool valid = mode_voxel_valid();
+	int grid_length = GRID_LENGTH;
+	int field_precision = voxel_ubo.field_precision;
+
+	// The first invocation of each brick speaks for it.
+	int brick_slot = group_brick();
+	bool brick_first = all(equal(ivec3(gl_LocalInvocationID) % 4, ivec3(0)));
+	if(brick_first)
+	{
+		brick_occupied_bits[brick_slot] = false;
+		brick_varying_bits[brick_slot] = false;
+	}
+	barrier();
+
+	// Already quantized, so it's stored exactly and compares equal to itself
+	// next frame. Compared against the front field, which is what's drawn
+	// this frame, so the brick is listed if what's drawn next frame differs.
+	float stored_color = field_quantize(color, field_precision);
+	if(valid)
+	{
+		if(stored_color > voxel_ubo.visibility_threshold)
+		{
+			brick_occupied_bits[brick_slot] = true;
+		}
+		if(stored_color != field_fetch_voxel(voxel, grid_length, field_precision))
+		{
+			brick_varying_bits[brick_slot] = true;
+		}
+	}
+	field_store(voxel, grid_length, field_precision, stored_color, valid);
+	barrier();
+
+	if(valid && brick_first)
+	{
+		int brick = brick_index(voxel / 4, grid_length);
+		int word = brick / 32;
+		uint bit = 1u << (brick % 32);
+		int varying_word = brick_words(grid_length) + word;
+
+		if(brick_occupied_bits[brick_slot])
+		{
+			atomicOr(brick_buffer.words[word], bit);
+		}
+		else
+		{
+			atomicAnd(brick_buffer.words[word], ~bit);
+		}
+
+		if(brick_varying_bits[brick_slot])
+		{
+			atomicOr(brick_buffer.words[varying_word], bit);
+		}
+		else
+		{
+			atomicAnd(brick_buffer.words[varying_word], ~bit);
+		}
+	}
+}
@@ -0,0 +1,36 @@
+// Z-order (Morton) curve, interleaving the bits of x, y and z with x lowest.
+// Written in the subset of C and GLSL the two share, so this is included by
+// both opengl.c and the shaders. Up to 10 bits per axis.
+
+// Spreads the low 10 bits of v out to every third bit.
+uint morton_spread(uint v)
+{
+	v &= 0x000003FFu;
+	v = (v | (v << 16)) & 0x030000FFu;
+	v = (v | (v << 8)) & 0x0300F00Fu;
+	v = (v | (v << 4)) & 0x030C30C3u;
+	v = (v | (v << 2)) & 0x09249249u;
+	return v;
+}
+
+// The inverse of morton_spread.
+uint morton_compact(uint v)
+{
+	v &= 0x09249249u;
+	v = (v | (v >> 2)) & 0x030C30C3u;
+	v = (v | (v >> 4)) & 0x0300F00Fu;
+	v = (v | (v >> 8)) & 0xFF0000FFu;
+	v = (v | (v >> 16)) & 0x000003FFu;
+	return v;
+}
+
+uint morton_encode(uint x, uint y, uint z)
+{
+	return morton_spread(x) | (morton_spread(y) << 1) | (morton_spread(z) << 2);
+}
+
+// Axis 0, 1 or 2 for x, y or z.
+uint morton_decode(uint code, uint axis)
+{
+	return morton_compact(code >> axis);
+}
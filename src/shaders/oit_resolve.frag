@@ -0,0 +1,20 @@
+#version 430 core
+out vec4 FragColor;
+
+layout(binding = 1) uniform sampler2D accumulation_texture;
+layout(binding = 2) uniform sampler2D revealage_texture;
+
+// Composites the weighted blended transparency targets over the framebuffer.
+// Drawn with volume.vert as a full screen triangle.
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float revealage = texelFetch(revealage_texture, pixel, 0).r;
+	if(revealage >= 1.0f)
+	{
+		discard;
+	}
+
+	vec4 accumulation = texelFetch(accumulation_texture, pixel, 0);
+	FragColor = vec4(accumulation.rgb / max(accumulation.a, 0.00001f), 1.0f - revealage);
+}
@@ -0,0 +1,39 @@
+#version 430 core
+#extension GL_ARB_shader_draw_parameters : require
+
+#include "field.glsl"
+#include "voxel_draw.glsl"
+
+// Only the visible voxels, already in back to front order. See compact.comp.
+layout(std430, binding = 3) buffer in_visible_voxel_buffer
+{
+	int map[];
+} visible_voxel_buffer;
+
+layout(std140, binding = 0) uniform in_ubo
+{
+	mat4 projection;
+	int grid_length;
+	float visibility_threshold;
+	int field_precision;
+} ubo;
+
+// The width of a cube drawn by voxel.vert, in world space.
+#define SPLAT_WORLD_SIZE (2.0f / 48.0f)
+
+out float f_color;
+
+// One point per visible voxel, sized to cover its cube on screen.
+void main()
+{
+	VoxelDraw draw = draw_params.draws[gl_DrawIDARB];
+	int voxel_id = visible_voxel_buffer.map[gl_VertexID];
+
+	vec3 offset = vec3(field_coordinates(voxel_id, ubo.grid_length));
+	offset += vec3(-(ubo.grid_length / 2.0f) + 0.5f);
+	offset /= 16.0f;
+
+	gl_Position = draw.projection * vec4(offset, 1.0f);
+	gl_PointSize = max(SPLAT_WORLD_SIZE * draw.splat_scale / gl_Position.w, 1.0f);
+	f_color = 0.05f + field_fetch(voxel_id, ubo.grid_length, ubo.field_precision);
+}
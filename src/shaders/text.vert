@@ -1,4 +1,5 @@
 #version 430 core
+#extension GL_ARB_shader_draw_parameters : require
 layout (location = 0) in vec2 in_position;
 
 struct Char
@@ -16,26 +17,36 @@ layout(std430, binding = 2) buffer in_text
 	Char chars[];
 } text;
 
-// The screen and font resolution, and the screen aspect ratio has been accounted
-// for on the CPU side and encoded in the transform matrix.
-layout(std140, binding = 0) uniform in_ubo
+// One per draw of the text batch, indexed by gl_DrawIDARB, see
+// gl_draw_batch.c. The screen and font resolution, and the screen aspect ratio
+// has been accounted for on the CPU side and encoded in the transform matrix.
+//
+// VOLATILE - this must match TextDraw in opengl.c.
+struct TextDraw
 {
 	mat2 transform;
-} ubo;
+	int first_char;
+};
+
+layout(std430, binding = 9) readonly buffer in_draw_params
+{
+	TextDraw draws[];
+} draw_params;
 
 out float f_color;
 out vec2 f_uv;
 
 void main()
 {
-	Char ch = text.chars[gl_InstanceID];
+	TextDraw draw = draw_params.draws[gl_DrawIDARB];
+	Char ch = text.chars[draw.first_char + gl_InstanceID];
 	
 	vec2 offset = vec2(-1.0f, 1.0f);
 	vec2 text_pos = vec2(
 		ch.x,
 		ch.y
 	) * ch.size * 2.0f;
-	gl_Position = vec4((ubo.transform * ((in_position * ch.size) + text_pos)) + offset, -1.0f, 1.0f);
+	gl_Position = vec4((draw.transform * ((in_position * ch.size) + text_pos)) + offset, -1.0f, 1.0f);
 	f_color = mix(ch.color, 1.0f, 0.0f);
 
 	int i = ch.index;
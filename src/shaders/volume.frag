@@ -0,0 +1,92 @@
+#version 430 core
+out vec4 FragColor;
+
+in vec2 f_ndc;
+
+layout(binding = 1) uniform sampler3D field_texture;
+layout(binding = 2) uniform sampler3D brick_texture;
+
+layout(std140, binding = 0) uniform in_ubo
+{
+	mat4 projection;
+	int grid_length;
+	float visibility_threshold;
+	vec3 camera_position;
+	mat4 inverse_projection;
+} ubo;
+
+// In cells. Small enough not to skip over the gaps between cubes.
+#define STEP 0.25f
+
+// Half the width of a cube drawn by the instanced renderer, in cells. Samples
+// outside of it are treated as empty so both renderers look alike.
+#define CUBE_EXTENT (1.0f / 3.0f)
+
+void main()
+{
+	vec4 near = ubo.inverse_projection * vec4(f_ndc, -1.0f, 1.0f);
+	vec4 far = ubo.inverse_projection * vec4(f_ndc, 1.0f, 1.0f);
+	near /= near.w;
+	far /= far.w;
+
+	// March in grid space, where each cell is one unit and the grid spans from
+	// 0 to grid_length. Voxels are 1/16 apart in world space, see voxel.vert.
+	float grid_length = float(ubo.grid_length);
+	vec3 origin = near.xyz * 16.0f + grid_length / 2.0f;
+	vec3 direction = normalize(far.xyz - near.xyz);
+	vec3 inverse_direction = 1.0f / direction;
+
+	vec3 t_low = (vec3(0.0f) - origin) * inverse_direction;
+	vec3 t_high = (vec3(grid_length) - origin) * inverse_direction;
+	vec3 t_min = min(t_low, t_high);
+	vec3 t_max = max(t_low, t_high);
+	float t_enter = max(max(max(t_min.x, t_min.y), t_min.z), 0.0f);
+	float t_exit = min(min(t_max.x, t_max.y), t_max.z);
+	if(t_enter >= t_exit)
+	{
+		discard;
+	}
+
+	// Front to back, premultiplied.
+	vec4 accumulated = vec4(0.0f);
+	float t = t_enter;
+	while(t < t_exit && accumulated.a < 0.99f)
+	{
+		vec3 point = origin + direction * t;
+		ivec3 cell = clamp(ivec3(point), ivec3(0), ivec3(ubo.grid_length - 1));
+
+		// Skip to the far side of bricks with nothing visible in them.
+		ivec3 brick = cell / 4;
+		if(texelFetch(brick_texture, brick, 0).r <= ubo.visibility_threshold)
+		{
+			vec3 brick_exit = (vec3(brick * 4) + step(0.0f, direction) * 4.0f - origin) * inverse_direction;
+			t = max(min(min(brick_exit.x, brick_exit.y), brick_exit.z), t) + 0.001f;
+			continue;
+		}
+
+		float color = texelFetch(field_texture, cell, 0).r;
+		bool in_cube = all(lessThan(abs(fract(point) - 0.5f), vec3(CUBE_EXTENT)));
+		if(in_cube && color > ubo.visibility_threshold)
+		{
+			// Matches voxel.frag, with the opacity of both walls of a cube
+			// spread over its width.
+			float f_color = 0.05f + color;
+			vec3 rgb = vec3(
+				mix(0.5f, 1.0f, f_color),
+				0.2f + mix(0.5f, 0.0f, f_color),
+				0.2f + mix(0.5f, 0.0f, f_color));
+			float alpha = 1.0f - pow(1.0f - clamp(f_color * 0.5f, 0.0f, 1.0f), STEP / CUBE_EXTENT);
+
+			accumulated.rgb += (1.0f - accumulated.a) * alpha * rgb;
+			accumulated.a += (1.0f - accumulated.a) * alpha;
+		}
+
+		t += STEP;
+	}
+
+	if(accumulated.a <= 0.0f)
+	{
+		discard;
+	}
+	FragColor = vec4(accumulated.rgb / accumulated.a, accumulated.a);
+}
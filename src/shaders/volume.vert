@@ -0,0 +1,10 @@
+#version 430 core
+
+out vec2 f_ndc;
+
+// A single triangle covering the screen, generated from the vertex id.
+void main()
+{
+	f_ndc = vec2((gl_VertexID & 1) * 4.0f - 1.0f, (gl_VertexID & 2) * 2.0f - 1.0f);
+	gl_Position = vec4(f_ndc, 0.0f, 1.0f);
+}
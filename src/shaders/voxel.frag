@@ -5,9 +5,13 @@ in float f_color;
 
 void main()
 {
+	// Only the camera facing half of each cube is drawn, so this covers looking
+	// through both its near and far walls.
+	float alpha = clamp(f_color * 0.5f, 0.0f, 1.0f);
+
     FragColor = vec4(
 	    mix(0.5f, 1.0f, f_color), 
 	    0.2f + mix(0.5f, 0.0f, f_color),
 	    0.2f + mix(0.5f, 0.0f, f_color),
-	    f_color * 0.5f);
+	    1.0f - (1.0f - alpha) * (1.0f - alpha));
 } 
@@ -1,33 +1,58 @@
 #version 430 core
-layout (location = 0) in vec3 in_position;
+#extension GL_ARB_shader_draw_parameters : require
 
-layout(std430, binding = 0) buffer in_color_buffer
-{
-	float colors[];
-} color_buffer;
+#include "field.glsl"
+#include "voxel_draw.glsl"
 
-layout(std430, binding = 1) buffer in_instance_to_voxel_buffer
+// Only the visible voxels, already in back to front order. See compact.comp.
+layout(std430, binding = 3) buffer in_visible_voxel_buffer
 {
 	int map[];
-} instance_to_voxel_buffer;
+} visible_voxel_buffer;
 
 layout(std140, binding = 0) uniform in_ubo
 {
 	mat4 projection;
 	int grid_length;
+	float visibility_threshold;
+	int field_precision;
 } ubo;
 
 out float f_color;
 
-// TODO - Frustum culling for when we are inside the cube, if we want that in the first place.
+// Each cube is pulled from the vertex id alone. Only the 3 faces looking
+// toward the camera are emitted, 2 triangles each, so 18 vertices are drawn
+// per instance instead of 36.
+const vec2 face_corners[6] = vec2[6](
+	vec2(-1.0f, -1.0f),
+	vec2( 1.0f, -1.0f),
+	vec2( 1.0f,  1.0f),
+	vec2( 1.0f,  1.0f),
+	vec2(-1.0f,  1.0f),
+	vec2(-1.0f, -1.0f));
+
+vec3 camera_facing_vertex(vec3 center, vec3 camera_position)
+{
+	int axis = gl_VertexID / 6;
+	vec2 corner = face_corners[gl_VertexID % 6];
+
+	vec3 position;
+	position[axis] = camera_position[axis] >= center[axis] ? 1.0f : -1.0f;
+	position[(axis + 1) % 3] = corner.x;
+	position[(axis + 2) % 3] = corner.y;
+	return position;
+}
+
+// Voxels outside the view frustum are already culled by brick in compact.comp.
 void main()
 {
-	int voxel_id = instance_to_voxel_buffer.map[gl_InstanceID];
+	VoxelDraw draw = draw_params.draws[gl_DrawIDARB];
+	int voxel_id = visible_voxel_buffer.map[gl_InstanceID];
 
-	vec3 offset = vec3(mod(voxel_id, ubo.grid_length), (voxel_id / ubo.grid_length) % ubo.grid_length, (voxel_id / ubo.grid_length) / ubo.grid_length);
+	vec3 offset = vec3(field_coordinates(voxel_id, ubo.grid_length));
 	offset += vec3(-(ubo.grid_length / 2.0f) + 0.5f);
 	offset /= 16.0f;
 
-	gl_Position = ubo.projection * vec4((in_position / 48.0f) + offset, 1.0f);
-	f_color = 0.05f + color_buffer.colors[voxel_id];
+	gl_Position = draw.projection * vec4((camera_facing_vertex(offset, draw.camera_position) / 48.0f) + offset, 1.0f);
+	f_color = 0.05f + field_fetch(voxel_id, ubo.grid_length, ubo.field_precision);
 }
@@ -0,0 +1,17 @@
+// The view each draw of a voxel batch is drawn from, indexed by gl_DrawIDARB.
+// The including shader must enable GL_ARB_shader_draw_parameters. See
+// gl_draw_batch.c.
+//
+// VOLATILE - this must match VoxelDraw in opengl.c.
+struct VoxelDraw
+{
+	mat4 projection;
+	vec3 camera_position;
+	// Converts a world space size at a clip space w of 1 to pixels.
+	float splat_scale;
+};
+
+layout(std430, binding = 9) readonly buffer in_draw_params
+{
+	VoxelDraw draws[];
+} draw_params;
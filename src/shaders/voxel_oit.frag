@@ -0,0 +1,24 @@
+#version 430 core
+layout (location = 0) out vec4 accumulation;
+layout (location = 1) out float revealage;
+
+in float f_color;
+
+// Weighted blended order independent transparency, see McGuire and Bavoil,
+// "Weighted Blended Order-Independent Transparency" (2013). Resolved by
+// oit_resolve.frag.
+void main()
+{
+	// Same color as voxel.frag.
+	float alpha = clamp(f_color * 0.5f, 0.0f, 1.0f);
+	vec4 color = vec4(
+	    mix(0.5f, 1.0f, f_color), 
+	    0.2f + mix(0.5f, 0.0f, f_color),
+	    0.2f + mix(0.5f, 0.0f, f_color),
+	    1.0f - (1.0f - alpha) * (1.0f - alpha));
+
+	float weight = clamp(color.a * max(0.01f, 3000.0f * pow(1.0f - gl_FragCoord.z, 3.0f)), 0.01f, 3000.0f);
+
+	accumulation = vec4(color.rgb * color.a, color.a) * weight;
+	revealage = color.a;
+}
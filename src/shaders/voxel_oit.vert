@@ -0,0 +1,60 @@
+#version 430 core
+#extension GL_ARB_shader_draw_parameters : require
+
+#include "field.glsl"
+#include "voxel_draw.glsl"
+
+layout(std140, binding = 0) uniform in_ubo
+{
+	mat4 projection;
+	int grid_length;
+	float visibility_threshold;
+	int field_precision;
+} ubo;
+
+out float f_color;
+
+// Each cube is pulled from the vertex id alone. Only the 3 faces looking
+// toward the camera are emitted, 2 triangles each, so 18 vertices are drawn
+// per instance instead of 36.
+const vec2 face_corners[6] = vec2[6](
+	vec2(-1.0f, -1.0f),
+	vec2( 1.0f, -1.0f),
+	vec2( 1.0f,  1.0f),
+	vec2( 1.0f,  1.0f),
+	vec2(-1.0f,  1.0f),
+	vec2(-1.0f, -1.0f));
+
+vec3 camera_facing_vertex(vec3 center, vec3 camera_position)
+{
+	int axis = gl_VertexID / 6;
+	vec2 corner = face_corners[gl_VertexID % 6];
+
+	vec3 position;
+	position[axis] = camera_position[axis] >= center[axis] ? 1.0f : -1.0f;
+	position[(axis + 1) % 3] = corner.x;
+	position[(axis + 2) % 3] = corner.y;
+	return position;
+}
+
+// Blending is order independent here, so each instance is simply its voxel.
+void main()
+{
+	VoxelDraw draw = draw_params.draws[gl_DrawIDARB];
+	int voxel_id = gl_InstanceID;
+	float color = field_fetch(voxel_id, ubo.grid_length, ubo.field_precision);
+
+	// Push invisible voxels outside the clip volume so they never rasterize.
+	if(color <= ubo.visibility_threshold)
+	{
+		gl_Position = vec4(2.0f, 2.0f, 2.0f, 1.0f);
+		return;
+	}
+
+	vec3 offset = vec3(field_coordinates(voxel_id, ubo.grid_length));
+	offset += vec3(-(ubo.grid_length / 2.0f) + 0.5f);
+	offset /= 16.0f;
+
+	gl_Position = draw.projection * vec4((camera_facing_vertex(offset, draw.camera_position) / 48.0f) + offset, 1.0f);
+	f_color = 0.05f + color;
+}
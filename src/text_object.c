@@ -0,0 +1,135 @@
+// Retained text. Each TextObject owns a fixed range of chars in a TextLayout,
+// laid out once and only touched again when its string, color or position
+// actually changes. Whatever changes is flagged per char, so the API can
+// upload just that, see gl_upload_text.
+
+#define TEXT_OBJECT_MAX_LENGTH 128
+
+typedef struct
+{
+	TextChar chars[TEXT_MAX_CHARS];
+	uint32_t count;
+	uint32_t dirty[TEXT_MAX_CHARS / 32];
+} TextLayout;
+
+typedef struct
+{
+	uint32_t first;
+	uint32_t capacity;
+	uint32_t length;
+
+	float position[2];
+	float size;
+	float color;
+	char string[TEXT_OBJECT_MAX_LENGTH];
+} TextObject;
+
+void text_layout_init(TextLayout* layout)
+{
+	layout->count = 0;
+	memset(layout->dirty, 0, sizeof(layout->dirty));
+}
+
+void text_layout_mark_dirty(TextLayout* layout, uint32_t first, uint32_t count)
+{
+	for(uint32_t i = first; i < first + count; i++)
+	{
+		layout->dirty[i / 32] |= 1u << (i % 32);
+	}
+}
+
+// Chars with a size of 0 draw nothing, see text.vert.
+void text_layout_clear(TextLayout* layout, uint32_t first, uint32_t count)
+{
+	for(uint32_t i = first; i < first + count; i++)
+	{
+		layout->chars[i].size = 0.0f;
+	}
+	text_layout_mark_dirty(layout, first, count);
+}
+
+// Only the chars that come out different are flagged, so a number ticking
+// over costs a char or two rather than the whole line.
+void text_object_layout(TextLayout* layout, TextObject* object)
+{
+	TextChar* chars = &layout->chars[object->first];
+	TextChar old_chars[TEXT_OBJECT_MAX_LENGTH];
+	uint32_t old_length = object->length;
+	memcpy(old_chars, chars, sizeof(TextChar) * old_length);
+
+	object->length = fill_text_buffer(object->string, chars, object->position, object->size, object->color);
+	for(uint32_t i = 0; i < object->length; i++)
+	{
+		if(i >= old_length || memcmp(&chars[i], &old_chars[i], sizeof(TextChar)) != 0)
+		{
+			text_layout_mark_dirty(layout, object->first + i, 1);
+		}
+	}
+
+	if(old_length > object->length)
+	{
+		text_layout_clear(layout, object->first + object->length, old_length - object->length);
+	}
+}
+
+// Reserves capacity chars for the object, which starts out empty.
+void text_object_init(TextLayout* layout, TextObject* object, uint32_t capacity, float x, float y, float size, float color)
+{
+	if(layout->count + capacity > TEXT_MAX_CHARS || capacity >= TEXT_OBJECT_MAX_LENGTH)
+	{
+		panic();
+	}
+
+	object->first = layout->count;
+	object->capacity = capacity;
+	object->length = 0;
+	object->position[0] = x;
+	object->position[1] = y;
+	object->size = size;
+	object->color = color;
+	object->string[0] = '\0';
+	layout->count += capacity;
+
+	text_layout_clear(layout, object->first, capacity);
+}
+
+// Strings longer than the object's capacity are cut short.
+void text_object_set_string(TextLayout* layout, TextObject* object, char* string)
+{
+	if(strncmp(object->string, string, object->capacity) == 0)
+	{
+		return;
+	}
+
+	strncpy(object->string, string, object->capacity);
+	object->string[object->capacity] = '\0';
+	text_object_layout(layout, object);
+}
+
+void text_object_set_position(TextLayout* layout, TextObject* object, float x, float y)
+{
+	if(object->position[0] == x && object->position[1] == y)
+	{
+		return;
+	}
+
+	object->position[0] = x;
+	object->position[1] = y;
+	text_object_layout(layout, object);
+}
+
+// Patched in place, without laying the string out again.
+void text_object_set_color(TextLayout* layout, TextObject* object, float color)
+{
+	if(object->color == color)
+	{
+		return;
+	}
+
+	object->color = color;
+	for(uint32_t i = 0; i < object->length; i++)
+	{
+		layout->chars[object->first + i].color = color;
+	}
+	text_layout_mark_dirty(layout, object->first, object->length);
+}
@@ -0,0 +1,106 @@
+// A persistently mapped buffer for everything uploaded each frame, split into
+// UPLOAD_RING_FRAMES partitions used in turn. Data is copied straight into
+// the mapping and bound with glBindBufferRange, so nothing goes through
+// glMapBuffer or glBufferSubData and nothing waits on the driver. A fence at
+// the end of each frame guards its partition until the GPU is done with it,
+// which only ever blocks if the GPU falls a whole ring behind.
+
+// Enough that the fence of a partition has always signaled by the time it
+// comes around again.
+#define UPLOAD_RING_FRAMES 3
+
+typedef struct
+{
+	uint32_t buffer;
+	uint8_t* memory;
+
+	uint32_t partition_size;
+	uint32_t alignment;
+
+	uint32_t partition;
+	uint32_t offset;
+	GLsync fences[UPLOAD_RING_FRAMES];
+} UploadRing;
+
+// Sized for up to pushes allocations totalling at most size bytes a frame.
+void upload_ring_init(UploadRing* ring, uint32_t size, uint32_t pushes)
+{
+	// Every allocation must be a valid offset for both uniform and storage
+	// buffer bindings.
+	int32_t ubo_alignment;
+	int32_t ssbo_alignment;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &ubo_alignment);
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &ssbo_alignment);
+	ring->alignment = ubo_alignment;
+	if(ssbo_alignment > ubo_alignment)
+	{
+		ring->alignment = ssbo_alignment;
+	}
+
+	// Each push is padded out to the alignment.
+	ring->partition_size = (size + ring->alignment * pushes + ring->alignment - 1) / ring->alignment * ring->alignment;
+	uint32_t ring_size = ring->partition_size * UPLOAD_RING_FRAMES;
+	uint32_t flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glCreateBuffers(1, &ring->buffer);
+	glNamedBufferStorage(ring->buffer, ring_size, NULL, flags);
+	ring->memory = glMapNamedBufferRange(ring->buffer, 0, ring_size, flags);
+	if(ring->memory == NULL)
+	{
+		panic();
+	}
+
+	ring->partition = 0;
+	ring->offset = 0;
+	for(uint32_t i = 0; i < UPLOAD_RING_FRAMES; i++)
+	{
+		ring->fences[i] = NULL;
+	}
+}
+
+// Moves on to the next partition, waiting for the GPU to be done with it if it
+// somehow isn't already.
+void upload_ring_begin_frame(UploadRing* ring)
+{
+	ring->partition = (ring->partition + 1) % UPLOAD_RING_FRAMES;
+	ring->offset = 0;
+
+	GLsync fence = ring->fences[ring->partition];
+	if(fence != NULL)
+	{
+		GLenum result = glClientWaitSync(fence, 0, 0);
+		while(result == GL_TIMEOUT_EXPIRED)
+		{
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		}
+		if(result == GL_WAIT_FAILED)
+		{
+			panic();
+		}
+
+		glDeleteSync(fence);
+		ring->fences[ring->partition] = NULL;
+	}
+}
+
+// Copies size bytes of data into this frame's partition and returns the
+// offset into the ring buffer to bind.
+uint32_t upload_ring_push(UploadRing* ring, void* data, uint32_t size)
+{
+	if(ring->offset + size > ring->partition_size)
+	{
+		panic();
+	}
+
+	uint32_t offset = ring->partition * ring->partition_size + ring->offset;
+	memcpy(&ring->memory[offset], data, size);
+	ring->offset += (size + ring->alignment - 1) / ring->alignment * ring->alignment;
+
+	return offset;
+}
+
+// Must come after the last command using this frame's partition.
+void upload_ring_end_frame(UploadRing* ring)
+{
+	ring->fences[ring->partition] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
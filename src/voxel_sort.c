@@ -1,146 +1,114 @@
-// TODO - We'll need to provide a rotation matrix to face the individual triangles away from the camera as well.
-void sort_voxels(int32_t* instance_to_voxel_map, uint32_t grid_length, uint32_t grid_area, uint32_t grid_volume, float* cam_pos)
-{
-	// All these variables suffexed "_term" will be 0 or 1, and are used to
-	// selectively terms we don't want in the final calculation.
-	int32_t x_positive_term = 0;
-	int32_t x_negative_term = 0;
-	int32_t x_unit_term = 0;
-	int32_t x_row_term = 0;
-	int32_t x_slice_term = 0;
-
-	int32_t y_positive_term = 0;
-	int32_t y_negative_term = 0;
-	int32_t y_unit_term = 0;
-	int32_t y_row_term = 0;
-	int32_t y_slice_term = 0;
-
-	int32_t z_positive_term = 0;
-	int32_t z_negative_term = 0;
-	int32_t z_unit_term = 0;
-	int32_t z_row_term = 0;
-	int32_t z_slice_term = 0;
+// The back to front ordering of the voxel grid only depends on which axis of
+// the camera position dominates, the order of the other two, and the sign of
+// each component. That gives 6 axis orders times 8 octants, and every one of
+// them is built once per grid size by sort.comp.
+//
+// VOLATILE - the encoding here must match the decoding in sort.comp, and
+// voxel_sort_voxel must match sort.comp.
+//
+// permutation = axis_order * 8 + octant
+// axis_order  = slice_axis * 2 + (row axis is the higher of the two remaining)
+// octant      = bit per axis, set when the camera is on the negative side
+#define SORT_PERMUTATIONS_COUNT 48
 
+uint32_t voxel_sort_permutation(float* cam_pos)
+{
 	float x_abs = fabs(cam_pos[0]);
 	float y_abs = fabs(cam_pos[1]);
 	float z_abs = fabs(cam_pos[2]);
 
+	uint32_t slice_axis;
+	uint32_t row_axis;
+	uint32_t unit_axis;
 	if(z_abs > y_abs)
 	{
 		if(z_abs > x_abs)
 		{
-			z_slice_term = 1;
+			slice_axis = 2;
 			if(x_abs > y_abs)
 			{
-				x_row_term = 1;
-				y_unit_term = 1;
+				row_axis = 0;
+				unit_axis = 1;
 			}
 			else
 			{
-				y_row_term = 1;
-				x_unit_term = 1;
+				row_axis = 1;
+				unit_axis = 0;
 			}
 		}
 		else
 		{
-			x_slice_term = 1;
-			z_row_term = 1;
-			y_unit_term = 1;
+			slice_axis = 0;
+			row_axis = 2;
+			unit_axis = 1;
 		}
 	}
 	else // y_abs > z_abs
 	{
-		printf("z not slicin! z: %f, x: %f\n", z_abs, x_abs);
 		if(y_abs > x_abs)
 		{
-			y_slice_term = 1;
+			slice_axis = 1;
 			if(z_abs > x_abs)
 			{
-				z_row_term = 1;
-				x_unit_term = 1;
+				row_axis = 2;
+				unit_axis = 0;
 			}
 			else
 			{
-				x_row_term = 1;
-				z_unit_term = 1;
+				row_axis = 0;
+				unit_axis = 2;
 			}
 		}
 		else
 		{
-			x_slice_term = 1;
-			y_row_term = 1;
-			z_unit_term = 1;
+			slice_axis = 0;
+			row_axis = 1;
+			unit_axis = 2;
 		}
 	}
 
-	if(cam_pos[0] >= 0)
-	{
-		x_positive_term = 1;
-	}
-	else
-	{
-		x_negative_term = 1;
-	}
+	uint32_t axis_order = slice_axis * 2 + (row_axis > unit_axis);
 
-	if(cam_pos[1] >= 0)
-	{
-		y_positive_term = 1;
-	}
-	else
+	uint32_t octant = 0;
+	for(uint32_t axis = 0; axis < 3; axis++)
 	{
-		y_negative_term = 1;
+		if(cam_pos[axis] < 0)
+		{
+			octant |= 1 << axis;
+		}
 	}
 
-	if(cam_pos[2] >= 0)
-	{
-		z_positive_term = 1;
-	}
-	else
-	{
-		z_negative_term = 1;
-	}
+	return axis_order * 8 + octant;
+}
 
-	if(1==0) // DBG voxel terms
-	{
-		printf("\033[2J\033[H");
-		printf("x_positive_term: %i\n", x_positive_term);
-		printf("x_negative_term: %i\n", x_negative_term);
-		printf("x_unit_term:     %i\n", x_unit_term);
-		printf("x_row_term:      %i\n", x_row_term);
-		printf("x_slice_term:    %i\n", x_slice_term);
-		printf("\n");
-		printf("y_positive_term: %i\n", y_positive_term);
-		printf("y_negative_term: %i\n", y_negative_term);
-		printf("y_unit_term:     %i\n", y_unit_term);
-		printf("y_row_term:      %i\n", y_row_term);
-		printf("y_slice_term:    %i\n", y_slice_term);
-		printf("\n");
-		printf("z_positive_term: %i\n", z_positive_term);
-		printf("z_negative_term: %i\n", z_negative_term);
-		printf("z_unit_term:     %i\n", z_unit_term);
-		printf("z_row_term:      %i\n", z_row_term);
-		printf("z_slice_term:    %i\n", z_slice_term);
-	}
+// The voxel the ordering for permutation puts at instance, where instance is
+// the unit, row and slice index. The same as sort.comp, for host side use.
+void voxel_sort_voxel(uint32_t permutation, uint32_t grid_length, uint32_t* instance, uint32_t* voxel)
+{
+	uint32_t axis_order = permutation / 8;
+	uint32_t octant = permutation % 8;
+
+	uint32_t slice_axis = axis_order / 2;
+	uint32_t low_axis = slice_axis == 0 ? 1 : 0;
+	uint32_t high_axis = slice_axis == 2 ? 1 : 2;
 
-	for(int32_t i = 0; i < grid_volume; i++)
+	uint32_t row_axis = low_axis;
+	uint32_t unit_axis = high_axis;
+	if(axis_order % 2 == 1)
 	{
-		int32_t unit_index = i % grid_length;
-		int32_t row_index = (i % grid_area) / grid_length;
-		int32_t slice_index = i / grid_area;
+		row_axis = high_axis;
+		unit_axis = low_axis;
+	}
 
-		int32_t x =
-			  (unit_index  * x_positive_term + (grid_length - 1 - unit_index)  * x_negative_term) * x_unit_term
-			+ (row_index   * x_positive_term + (grid_length - 1 - row_index)   * x_negative_term) * x_row_term
-			+ (slice_index * x_positive_term + (grid_length - 1 - slice_index) * x_negative_term) * x_slice_term;
-		int32_t y =
-			  (unit_index  * y_positive_term + (grid_length - 1 - unit_index)  * y_negative_term) * y_unit_term
-			+ (row_index   * y_positive_term + (grid_length - 1 - row_index)   * y_negative_term) * y_row_term
-			+ (slice_index * y_positive_term + (grid_length - 1 - slice_index) * y_negative_term) * y_slice_term;
-		int32_t z =
-			  (unit_index  * z_positive_term + (grid_length - 1 - unit_index)  * z_negative_term) * z_unit_term
-			+ (row_index   * z_positive_term + (grid_length - 1 - row_index)   * z_negative_term) * z_row_term
-			+ (slice_index * z_positive_term + (grid_length - 1 - slice_index) * z_negative_term) * z_slice_term;
+	voxel[unit_axis] = instance[0];
+	voxel[row_axis] = instance[1];
+	voxel[slice_axis] = instance[2];
 
-		instance_to_voxel_map[i] = z * grid_area + y * grid_length + x;
+	for(uint32_t axis = 0; axis < 3; axis++)
+	{
+		if((octant & (1 << axis)) != 0)
+		{
+			voxel[axis] = grid_length - 1 - voxel[axis];
+		}
 	}
 }
@@ -8,6 +8,9 @@
 #include <stdbool.h>
 #include <string.h>
 #include <time.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <unistd.h>
 
 #include "cglm/cglm.h"
 
@@ -19,6 +22,7 @@
 #include "input.c"
 #include "game.c"
 #include "opengl.c"
+#include "layout_bench.c"
 
 typedef GLXContext(*glXCreateContextAttribsARBProc)(Display*, GLXFBConfig, GLXContext, Bool, const int*);
 
@@ -45,6 +49,30 @@ int32_t main(int32_t argc, char** argv)
 {
 	XlibContext xlib;
 
+	// Options
+	GlOptions gl_options = { .field_storage = FIELD_STORAGE_BUFFER, .field_layout = FIELD_LAYOUT_LINEAR };
+	bool tune = false;
+	for(int32_t i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--field-image") == 0)
+		{
+			gl_options.field_storage = FIELD_STORAGE_IMAGE;
+		}
+		else if(strcmp(argv[i], "--field-morton") == 0)
+		{
+			gl_options.field_layout = FIELD_LAYOUT_MORTON;
+		}
+		else if(strcmp(argv[i], "--bench-layout") == 0)
+		{
+			layout_bench_run();
+			return 0;
+		}
+		else if(strcmp(argv[i], "--tune") == 0)
+		{
+			tune = true;
+		}
+	}
+
 	xlib.display = XOpenDisplay(0);
 	if(xlib.display == NULL) 
 	{
@@ -203,7 +231,12 @@ int32_t main(int32_t argc, char** argv)
 	//XSync(xlib.display, 1);
 
 	game_init(&xlib.game);
-	gl_init(&xlib.gl, &xlib.game);
+	gl_init(&xlib.gl, &xlib.game, &gl_options);
+	if(tune)
+	{
+		gl_tune_mode_kernels(&xlib.gl, &xlib.game);
+		return 0;
+	}
 
 	XWindowAttributes window_attributes;
 	XGetWindowAttributes(xlib.display, xlib.window, &window_attributes);
@@ -460,6 +493,26 @@ int32_t main(int32_t argc, char** argv)
 							input_button_press(&input->change_mode);
 							break;
 						}
+						case XK_v:
+						{
+							input_button_press(&input->change_renderer);
+							break;
+						}
+						case XK_bracketright:
+						{
+							input_button_press(&input->grow_grid);
+							break;
+						}
+						case XK_bracketleft:
+						{
+							input_button_press(&input->shrink_grid);
+							break;
+						}
+						case XK_p:
+						{
+							input_button_press(&input->change_precision);
+							break;
+						}
 						default: break;
 					}
 					break;
@@ -554,6 +607,26 @@ int32_t main(int32_t argc, char** argv)
 							input_button_release(&input->change_mode);
 							break;
 						}
+						case XK_v:
+						{
+							input_button_release(&input->change_renderer);
+							break;
+						}
+						case XK_bracketright:
+						{
+							input_button_release(&input->grow_grid);
+							break;
+						}
+						case XK_bracketleft:
+						{
+							input_button_release(&input->shrink_grid);
+							break;
+						}
+						case XK_p:
+						{
+							input_button_release(&input->change_precision);
+							break;
+						}
 						default: break;
 					}
 					break;